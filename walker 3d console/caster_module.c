@@ -0,0 +1,166 @@
+#include "caster_module.h"
+#include <stdlib.h>
+#include <math.h>
+#include <ncurses.h>
+#include "../walker 3d multiplayer/alloc_module.h"
+
+object_t caster_map[MAP_SIZE][MAP_SIZE];
+
+static void add_random_obsticles();
+
+static int sign(int a) {
+    return (a > 0) - (a < 0);
+}
+
+object_t caster_create_object(int type) {
+    object_t object;
+    switch (type)
+    {
+    case OBSTICLE_TYPE:
+        object.color = rand() % 7 + 1;
+        object.symbol = OBSTICLE_SYMBOL;
+        object.type = OBSTICLE_TYPE;
+        break;
+    case MIRROR_TYPE:
+        object.symbol = MIRROR_SYMBOL;
+        object.type = MIRROR_TYPE;
+        break;
+    case VOID_TYPE:
+        object.symbol = EMPTY_SYMBOL;
+        object.type = VOID_TYPE;
+        object.color = COLOR_BLACK;
+        break;
+    default:
+        return object;
+    }
+
+    return object;
+}
+
+void caster_initialize_map() {
+    for (int i = 0; i < MAP_SIZE; i++) {
+        for (int j = 0; j < MAP_SIZE; j++) {
+            // Set borders
+            if (i == 0 || i == MAP_SIZE - 1 || j == 0 || j == MAP_SIZE - 1) {
+                caster_map[i][j] = caster_create_object(OBSTICLE_TYPE);
+            } else {
+                caster_map[i][j] = caster_create_object(VOID_TYPE);
+            }
+        }
+    }
+    add_random_obsticles();
+}
+
+static void add_random_obsticles() {
+    int wall_count = 100;
+    for (int i = 0; i < wall_count; i++) {
+        int x = rand() % (MAP_SIZE - 2) + 1;
+        int y = rand() % (MAP_SIZE - 2) + 1;
+
+        // if (rand() % 2 == 0) {
+        //     caster_map[x][y] = caster_create_object(MIRROR_TYPE);
+        // } else {
+        //     caster_map[x][y] = caster_create_object(MIRROR_TYPE);
+        // }
+        // caster_map[x][y] = caster_create_object(OBSTICLE_TYPE);
+
+    }
+
+    for (int j = 10; j < 40; j++) {
+        caster_map[20][j] = caster_create_object(MIRROR_TYPE); // Horizontal wall at row 20
+    }
+}
+
+bool caster_wall_collision(double dx, double dy, double pos_x, double pos_y) {
+    return caster_map[(int)(pos_y + dy)][(int)(pos_x + dx)].type == OBSTICLE_TYPE;
+}
+
+bool caster_player_colision(player_t* player, double dx, double dy, double pos_x, double pos_y) {
+    return ((int) player -> x == (int)(pos_x + dx)) && ((int)player -> y == (int)(pos_y + dy));
+}
+
+ray_t* caster_create_rays(player_t* player, char buffer[MAP_SIZE][MAP_SIZE], int ray_count,
+                          caster_stats_t* stats) {
+    ray_t* rays = malloc(sizeof(ray_t) * ray_count);
+    if (!rays) return NULL;
+    double render_step = CASTER_VIEW_ANGLE / ray_count;
+
+    for (int i = 0; i < ray_count; i += 1) {
+        double pos_x = (double) player->x;
+        double pos_y = (double) player->y;
+
+        double ray_angle = player->angleXY - CASTER_VIEW_ANGLE / 2 + i * render_step;
+
+        double dx = cos(ray_angle);
+        double dy = sin(ray_angle);
+
+        bool is_reflected = false;
+        bool is_player = false;
+
+        double total_distance = 0;
+        while (!caster_wall_collision(dx, dy, pos_x, pos_y) && total_distance < CASTER_MAX_RAY_LENGHT) {
+            stats->steps++;
+            if (is_reflected && caster_player_colision(player, dx, dy, pos_x, pos_y)) {
+                pos_x += dx;
+                pos_y += dy;
+                buffer[(int)(pos_y)][(int)(pos_x)] = '.';
+                total_distance += sqrt(dx * dx + dy * dy);
+                is_player = true;
+                break;
+            }
+            switch (caster_map[(int)(pos_y + dy)][(int)(pos_x + dx)].type) {
+                case VOID_TYPE:
+                    pos_x += dx;
+                    pos_y += dy;
+                    buffer[(int)(pos_y)][(int)(pos_x)] = '.';
+                    total_distance += sqrt(dx * dx + dy * dy);
+                break;
+                case MIRROR_TYPE:
+                    is_reflected = true;
+                    stats->bounces++;
+                    if (caster_map[(int) pos_y][(int)(pos_x + sign(dx))].type == MIRROR_TYPE) {
+                        dx *= -1;
+                    } else {
+                        dy *= -1;
+                    }
+                    pos_x += dx;
+                    pos_y += dy;
+                    buffer[(int)(pos_y)][(int)(pos_x)] = '.';
+                    total_distance += sqrt(dx * dx + dy * dy);
+                break;
+            }
+        }
+
+        ray_t ray;
+
+        // ray.end_x = pos_x;
+        // ray.end_y = pos_y;
+        // ray.obsticle = caster_map[(int)(pos_y + dy)][(int)(pos_x + dx)];
+        ray.index = i;
+        ray.lenght = total_distance;
+        ray.is_player = is_player;
+        if (is_player) {
+            ray.color = player->color;
+        } else {
+            ray.color = caster_map[(int) (pos_y + dy)][(int) (pos_x + dx)].color;
+        }
+        *(rays + i) = ray;
+    }
+
+
+    double view_x = player->x;
+    double view_y = player->y;
+
+    double dx = cos(player->angleXY);
+    double dy = sin(player->angleXY);
+
+    // where player looks
+    while (caster_map[(int)(view_y + dy)][(int)(view_x + dx)].type == VOID_TYPE) {
+        buffer[(int)(view_y + dy)][(int)(view_x + dx)] = '^';
+        view_x += dx;
+        view_y += dy;
+    }
+
+
+    return rays;
+}
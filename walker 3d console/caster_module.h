@@ -0,0 +1,65 @@
+#ifndef CASTER_MODULE_H
+#define CASTER_MODULE_H
+
+#include <stdbool.h>
+
+// 2D world of the console walker. Exported names carry a caster_ prefix so the
+// caster can be linked next to the 3D map_module.
+
+#define MAP_SIZE 40
+#define CASTER_MAX_RAY_LENGHT 80
+#define CASTER_VIEW_ANGLE (M_PI / 2)
+#define CASTER_RAY_COUNT 314 // one ray per 0.005 rad of the view angle
+
+#define VOID_TYPE 0
+#define OBSTICLE_TYPE 1
+#define MIRROR_TYPE 2
+
+#define OBSTICLE_SYMBOL '#'
+#define MIRROR_SYMBOL 'M'
+#define EMPTY_SYMBOL ' '
+
+typedef struct object {
+    int color;
+    int type;
+    char symbol;
+} object_t;
+
+typedef struct player {
+    double x;
+    double y;
+    double angleXY;
+    int color;
+} player_t;
+
+typedef struct ray {
+    double end_x;
+    double end_y;
+    int index;
+    double lenght;
+    bool is_player;
+
+    int color;
+} ray_t;
+
+// Work done by caster_create_rays
+typedef struct caster_stats {
+    int steps;
+    int bounces;
+} caster_stats_t;
+
+extern object_t caster_map[MAP_SIZE][MAP_SIZE];
+
+// Draws from rand(), seed it with srand() first for a reproducible world
+void caster_initialize_map();
+object_t caster_create_object(int type);
+
+bool caster_wall_collision(double dx, double dy, double pos_x, double pos_y);
+bool caster_player_colision(player_t* player, double dx, double dy, double pos_x, double pos_y);
+
+// Casts `ray_count` rays over the view angle. Marks the cells the rays pass and the line
+// of sight in `buffer`.
+ray_t* caster_create_rays(player_t* player, char buffer[MAP_SIZE][MAP_SIZE], int ray_count,
+                          caster_stats_t* stats);
+
+#endif // CASTER_MODULE_H
@@ -6,8 +6,12 @@
 #include <math.h> 
 #include <ncurses.h>
 #include <stdbool.h>
+#include <string.h>
+#include "../walker 3d multiplayer/shade_module.h"
+#include "../walker 3d multiplayer/trace_module.h"
+#include "caster_module.h"
+#include "../walker 3d multiplayer/alloc_module.h"
 
-#define MAP_SIZE 40
 #define PLAYER_AVATAR '@'
 #define OBSTICLE '#'
 #define MIRROR 'M'
@@ -16,99 +20,102 @@
 #define MINIMAP_WIDTH 36
 
 
-const double max_ray_lenght = 80;
-const double RENDER_STEP = 0.005;
-const double VIEW_ANGLE = M_PI/2;
 const double CAMERA_SPEED = M_PI / 24;
 const double brightnest_level = 5;
 
-typedef struct object {
-    int color;
-    int type;
-    char symbol;
-} object_t;
-
-typedef struct player {
-    double x;
-    double y;
-    double angleXY;
-    int color;
-} player_t;
-
-typedef struct ray {
-    double end_x;
-    double end_y;
-    int index;
-    double lenght;
-    bool is_player;
-
-    int color;
-} ray_t;
-
 typedef struct frame {
     char buffer[MAP_SIZE][MAP_SIZE];
     ray_t* rays;
 } frame_t;
 
 
-const int VOID_TYPE = 0;
-const int OBSTICLE_TYPE = 1;
-const int MIRROR_TYPE = 2;
-
-const char OBSTICLE_SYMBOL = '#';
-const char MIRROR_SYMBOL = 'M';
-const char EMPTY_SYMBOL = ' ';
-
-static object_t map[MAP_SIZE][MAP_SIZE];
-const double obsticle_width = 2;
+shade_table_t shade_table;
 
 void init_ncyrses();
-void initialize_map();
-void add_random_obsticles();
 void enable_raw_mode();
 void disable_raw_mode();
 void init_player(player_t* player);
 frame_t create_frame(player_t* player, bool write_map);
 void update_player(int input, player_t* player);
-ray_t* create_rays(player_t* player, char buffer[MAP_SIZE][MAP_SIZE]);
 void draw_frame(frame_t* frame, player_t* player);
 char get_wall_char(ray_t* ray);
-bool wall_collision(double dx, double dy, double pos_x, double pos_y);
-bool player_colision(player_t* player, double dx, double dy, double pos_x, double pos_y);
-int sign(int a);
-object_t create_object(int type);
 int min_int(int a, int b);
 int max_int(int a, int b);
 void render_minimap(frame_t* frame, player_t* player, bool frame_color);
 
-int main() {
+int main(int argc, char** argv) {
+    unsigned int seed = time(NULL);
+    const char* record_name = NULL;
+    const char* replay_name = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (sscanf(argv[i], "--seed=%u", &seed) == 1) {
+            continue;
+        } else if (strncmp(argv[i], "--record=", 9) == 0) {
+            record_name = argv[i] + 9;
+        } else if (strncmp(argv[i], "--replay=", 9) == 0) {
+            replay_name = argv[i] + 9;
+        } else {
+            fprintf(stderr, "Usage: %s [--seed=N] [--record=TRACE | --replay=TRACE]\n", argv[0]);
+            return 1;
+        }
+    }
+    // a replay runs the recorded world and keys without a terminal, as fast as possible
+    trace_t* replay = NULL;
+    if (replay_name) {
+        replay = trace_open_replay(replay_name, TRACE_WALKER_CONSOLE);
+        if (!replay) return 1;
+        seed = replay->seed;
+    }
+
     player_t player;
     init_player(&player);
 
-    initialize_map();
+    srand(seed);
+    caster_initialize_map();
+    build_shade_table(&shade_table, DEFAULT_SHADE_RAMP, brightnest_level, NO_FOG, NO_FOG, 0);
 
-    enable_raw_mode();
+    if (replay) {
+        if (start_replay_screen(replay->lines, replay->cols) != 0) return 1;
+    } else {
+        enable_raw_mode();
+    }
 
     init_ncyrses();
+    trace_t* record = NULL;
+    if (record_name) {
+        record = trace_open_record(record_name, TRACE_WALKER_CONSOLE, seed, LINES, COLS);
+    }
     int input;
     do {
+        double frame_start = trace_clock_ms();
         frame_t frame = create_frame(&player, false);
         draw_frame(&frame, &player);
 
-        input = getchar();
+        if (replay) {
+            input = trace_next_key(replay);
+            if (input == EOF) input = 'x';
+        } else {
+            input = getchar();
+        }
+        if (record) trace_record_key(record, input);
         update_player(input, &player);
 
         free(frame.rays);
+        if (replay) trace_frame_time(replay, input, trace_clock_ms() - frame_start);
     } while (input != 'x');
 
-    disable_raw_mode();
+    if (!replay) disable_raw_mode();
 
     endwin();
+    trace_close(record);
+    trace_close(replay);
     return 0;
 }
 
 void init_ncyrses() {
-    initscr();
+    if (!stdscr) {
+        initscr(); // a replay has already set up its own screen
+    }
     cbreak();
     noecho();
     keypad(stdscr, TRUE);
@@ -124,67 +131,6 @@ void init_ncyrses() {
     init_pair(7, COLOR_WHITE, COLOR_BLACK);
 }
 
-object_t create_object(int type) {
-    object_t object;
-    switch (type)
-    {
-    case OBSTICLE_TYPE:
-        object.color = rand() % 7 + 1;
-        object.symbol = OBSTICLE_SYMBOL;
-        object.type = OBSTICLE_TYPE;
-        break;
-    case MIRROR_TYPE:
-        object.symbol = MIRROR_SYMBOL;
-        object.type = MIRROR_TYPE;
-        break;
-    case VOID_TYPE:
-        object.symbol = EMPTY_SYMBOL;
-        object.type = VOID_TYPE;
-        object.color = COLOR_BLACK;
-        break;
-    default:
-        return object;
-    }
-
-    return object;
-}
-
-void initialize_map() {
-    for (int i = 0; i < MAP_SIZE; i++) {
-        for (int j = 0; j < MAP_SIZE; j++) {
-            // Set borders
-            if (i == 0 || i == MAP_SIZE - 1 || j == 0 || j == MAP_SIZE - 1) {
-                map[i][j] = create_object(OBSTICLE_TYPE); 
-            } else {
-                map[i][j] = create_object(VOID_TYPE); 
-            }
-        }
-    }
-    add_random_obsticles();
-}
-
-void add_random_obsticles() {
-    srand(time(NULL)); 
-
-    int wall_count = 100;
-    for (int i = 0; i < wall_count; i++) {
-        int x = rand() % (MAP_SIZE - 2) + 1; 
-        int y = rand() % (MAP_SIZE - 2) + 1; 
-
-        // if (rand() % 2 == 0) {
-        //     map[x][y] = create_object(MIRROR_TYPE); 
-        // } else {
-        //     map[x][y] = create_object(MIRROR_TYPE); 
-        // }
-        // map[x][y] = create_object(OBSTICLE_TYPE); 
-
-    }
-
-    for (int j = 10; j < 40; j++) {
-        map[20][j] = create_object(MIRROR_TYPE); // Horizontal wall at row 20
-    }
-}
-
 void enable_raw_mode() {
     struct termios t;
     tcgetattr(STDIN_FILENO, &t);
@@ -248,11 +194,12 @@ frame_t create_frame(player_t* player, bool write_map) {
     char buffer[MAP_SIZE][MAP_SIZE];
     for (int i = 0; i < MAP_SIZE; i++) {
         for (int j = 0; j < MAP_SIZE; j++) {
-            buffer[i][j] = map[i][j].symbol;
+            buffer[i][j] = caster_map[i][j].symbol;
         }
     }
 
-    ray_t* rays = create_rays(player, buffer);
+    caster_stats_t stats = {0, 0};
+    ray_t* rays = caster_create_rays(player, buffer, CASTER_RAY_COUNT, &stats);
     buffer[(int) player->y][(int) player->x] = PLAYER_AVATAR;
 
     if (write_map) {
@@ -278,95 +225,6 @@ frame_t create_frame(player_t* player, bool write_map) {
     return frame;
 }
 
-bool wall_collision(double dx, double dy, double pos_x, double pos_y) {
-    return map[(int)(pos_y + dy)][(int)(pos_x + dx)].type == OBSTICLE_TYPE;
-}
-
-bool player_colision(player_t* player, double dx, double dy, double pos_x, double pos_y) {
-    return ((int) player -> x == (int)(pos_x + dx)) && ((int)player -> y == (int)(pos_y + dy));
-}
-
-ray_t* create_rays(player_t* player, char buffer[MAP_SIZE][MAP_SIZE]) {
-    ray_t* rays = malloc(sizeof(ray_t) * (int) (VIEW_ANGLE / RENDER_STEP));
-
-    for (int i = 0; (double) i * RENDER_STEP < VIEW_ANGLE; i += 1) {
-        double pos_x = (double) player->x;
-        double pos_y = (double) player->y;
-
-        double ray_angle = player->angleXY - VIEW_ANGLE / 2 + i * RENDER_STEP;
-
-        double dx = cos(ray_angle);
-        double dy = sin(ray_angle);
-
-        bool is_reflected = false;
-        bool is_player = false;
-
-        double total_distance = 0;
-        while (!wall_collision(dx, dy, pos_x, pos_y) && total_distance < max_ray_lenght) {
-            if (is_reflected && player_colision(player, dx, dy, pos_x, pos_y)) {
-                pos_x += dx;
-                pos_y += dy;
-                buffer[(int)(pos_y)][(int)(pos_x)] = '.';
-                total_distance += sqrt(dx * dx + dy * dy);
-                is_player = true;
-                break;
-            }
-            switch (map[(int)(pos_y + dy)][(int)(pos_x + dx)].type) {
-                case VOID_TYPE:
-                    pos_x += dx;
-                    pos_y += dy;
-                    buffer[(int)(pos_y)][(int)(pos_x)] = '.';
-                    total_distance += sqrt(dx * dx + dy * dy);
-                break;
-                case MIRROR_TYPE:
-                    is_reflected = true;
-                    if (map[(int) pos_y][(int)(pos_x + sign(dx))].type == MIRROR_TYPE) {
-                        dx *= -1;
-                    } else {
-                        dy *= -1;
-                    }
-                    pos_x += dx;
-                    pos_y += dy;
-                    buffer[(int)(pos_y)][(int)(pos_x)] = '.';
-                    total_distance += sqrt(dx * dx + dy * dy);
-                break;
-            }
-        }
-
-        ray_t ray;
-
-        // ray.end_x = pos_x;
-        // ray.end_y = pos_y;
-        // ray.obsticle = map[(int)(pos_y + dy)][(int)(pos_x + dx)];
-        ray.index = i;
-        ray.lenght = total_distance;
-        ray.is_player = is_player;
-        if (is_player) {
-            ray.color = player->color;
-        } else {
-            ray.color = map[(int) (pos_y + dy)][(int) (pos_x + dx)].color;
-        }
-        *(rays + i) = ray;
-    }
-
-
-    double view_x = player->x;
-    double view_y = player->y;
-
-    double dx = cos(player->angleXY);
-    double dy = sin(player->angleXY);
-
-    // where player looks
-    while (map[(int)(view_y + dy)][(int)(view_x + dx)].type == VOID_TYPE) {
-        buffer[(int)(view_y + dy)][(int)(view_x + dx)] = '^';
-        view_x += dx;
-        view_y += dy;
-    }
-
-
-    return rays;
-}
-
 void draw_frame(frame_t* frame, player_t* player) {
     clear(); 
 
@@ -374,7 +232,7 @@ void draw_frame(frame_t* frame, player_t* player) {
     double screen_height = LINES; // Terminal height
 
     ray_t* rays = frame->rays;
-    int num_rays = (int)(VIEW_ANGLE / RENDER_STEP);
+    int num_rays = CASTER_RAY_COUNT;
 
     for (int i = 0; i < num_rays; i++) {
         ray_t current_ray = rays[i];
@@ -389,16 +247,13 @@ void draw_frame(frame_t* frame, player_t* player) {
 
         int color = current_ray.color;
 
-        attron(COLOR_PAIR(color));
-        for (int y = start_y; y < end_y; y++) {
-            if (y >= 0 && y < screen_height) { 
-                char wall = get_wall_char(&current_ray);
-
-                mvaddch(y, i * (screen_width / num_rays), wall); 
-
-            }
+        // one character per column, drawn as a single vertical run
+        char wall = get_wall_char(&current_ray);
+        int first_y = start_y < 0 ? 0 : start_y;
+        int last_y = end_y > screen_height ? screen_height : end_y;
+        if (last_y > first_y) {
+            mvvline(first_y, i * (screen_width / num_rays), wall | COLOR_PAIR(color), last_y - first_y);
         }
-        attroff(COLOR_PAIR(color));
 
     }
 
@@ -445,21 +300,21 @@ void render_minimap(frame_t* frame, player_t* player, bool frame_color) {
         for (int j = start_j; j < end_j; j++) {
             if (frame_color && frame->buffer[i][j] == '#') {
                 char color_type;
-                if(map[i][j].color == COLOR_BLACK) {
+                if(caster_map[i][j].color == COLOR_BLACK) {
                     continue;
-                } else if(map[i][j].color == COLOR_RED) {
+                } else if(caster_map[i][j].color == COLOR_RED) {
                     color_type = 'R';
-                } else if(map[i][j].color == COLOR_GREEN) {
+                } else if(caster_map[i][j].color == COLOR_GREEN) {
                     color_type = 'G';
-                } else if(map[i][j].color == COLOR_YELLOW) {
+                } else if(caster_map[i][j].color == COLOR_YELLOW) {
                     color_type = 'Y';
-                } else if(map[i][j].color == COLOR_BLUE) {
+                } else if(caster_map[i][j].color == COLOR_BLUE) {
                     color_type = 'b';
-                } else if(map[i][j].color == COLOR_MAGENTA) {
+                } else if(caster_map[i][j].color == COLOR_MAGENTA) {
                     color_type = 'M';
-                } else if(map[i][j].color == COLOR_CYAN) {
+                } else if(caster_map[i][j].color == COLOR_CYAN) {
                     color_type = 'C';
-                } else if(map[i][j].color == COLOR_WHITE) {
+                } else if(caster_map[i][j].color == COLOR_WHITE) {
                     color_type = 'W';
                 }
         
@@ -472,20 +327,8 @@ void render_minimap(frame_t* frame, player_t* player, bool frame_color) {
 }
 
 char get_wall_char(ray_t* ray) {
-    if (ray -> is_player) {
-        return '#';
-    }
-    char bightnes[10] = {'@', '%', '*', ';',  '+', '=', '-', ':', '.', ' '};
-
-    int index = ray -> lenght / brightnest_level;
-    if (index > sizeof(bightnes)) {
-        return ' ';
-    }
-    return bightnes[index];
-}
-
-int sign(int a) {
-    return (a > 0) - (a < 0);
+    return shade_char(&shade_table, ray->lenght, ray->is_player ? SHADE_FLAG_PLAYER : 0,
+                      SHADE_FULL_LIGHT);
 }
 
 int min_int(int a, int b) {
@@ -0,0 +1,181 @@
+#define ALLOC_MODULE_C
+#include "alloc_module.h"
+
+#ifdef ALLOC_TRACKING
+
+#include <stddef.h>
+#include <string.h>
+
+#define ALLOC_MAX_SITES 256
+#define ALLOC_MAGIC 0x616c6c6f
+
+typedef struct {
+    const char* file; // NULL for the overflow site
+    int line;
+    long frame_count;
+    long frame_bytes;
+    long total_count;
+    long total_bytes;
+    long live_count;
+    long live_bytes;
+} alloc_site_t;
+
+// Sits in front of every tracked block, padded to keep the block aligned
+typedef union {
+    struct {
+        size_t size;
+        int site;
+        int magic;
+    } info;
+    max_align_t align;
+} alloc_header_t;
+
+static alloc_site_t sites[ALLOC_MAX_SITES];
+static int site_count = 0;
+static long frames = 0;
+static long frame_count = 0;
+static long frame_bytes = 0;
+static int report_registered = 0;
+
+static void alloc_report_at_exit();
+
+static int find_site(const char* file, int line) {
+    for (int i = 0; i < site_count; i++) {
+        if (sites[i].line == line && sites[i].file == file) return i;
+    }
+    if (!report_registered) {
+        report_registered = 1;
+        atexit(alloc_report_at_exit);
+    }
+    if (site_count == ALLOC_MAX_SITES - 1) {
+        return ALLOC_MAX_SITES - 1; // every further site shares the overflow entry
+    }
+    sites[site_count].file = file;
+    sites[site_count].line = line;
+    return site_count++;
+}
+
+static void count_allocation(alloc_header_t* header, size_t size, const char* file, int line) {
+    int site = find_site(file, line);
+    header->info.size = size;
+    header->info.site = site;
+    header->info.magic = ALLOC_MAGIC;
+    sites[site].frame_count++;
+    sites[site].frame_bytes += size;
+    sites[site].total_count++;
+    sites[site].total_bytes += size;
+    sites[site].live_count++;
+    sites[site].live_bytes += size;
+    frame_count++;
+    frame_bytes += size;
+}
+
+static alloc_header_t* header_of(void* block) {
+    alloc_header_t* header = (alloc_header_t*)block - 1;
+    if (header->info.magic != ALLOC_MAGIC) {
+        fprintf(stderr, "alloc: %p was not allocated by the tracker\n", block);
+        abort();
+    }
+    return header;
+}
+
+static void count_release(alloc_header_t* header) {
+    alloc_site_t* site = &sites[header->info.site];
+    site->live_count--;
+    site->live_bytes -= header->info.size;
+}
+
+void* tracked_malloc(size_t size, const char* file, int line) {
+    alloc_header_t* header = malloc(sizeof(alloc_header_t) + size);
+    if (!header) return NULL;
+    count_allocation(header, size, file, line);
+    return header + 1;
+}
+
+void* tracked_calloc(size_t count, size_t size, const char* file, int line) {
+    alloc_header_t* header = calloc(1, sizeof(alloc_header_t) + count * size);
+    if (!header) return NULL;
+    count_allocation(header, count * size, file, line);
+    return header + 1;
+}
+
+void* tracked_realloc(void* block, size_t size, const char* file, int line) {
+    if (!block) return tracked_malloc(size, file, line);
+    alloc_header_t* header = header_of(block);
+    alloc_header_t moved_info = *header;
+    alloc_header_t* moved = realloc(header, sizeof(alloc_header_t) + size);
+    if (!moved) return NULL;
+    count_release(&moved_info);
+    count_allocation(moved, size, file, line);
+    return moved + 1;
+}
+
+void tracked_free(void* block) {
+    if (!block) return;
+    alloc_header_t* header = header_of(block);
+    count_release(header);
+    header->info.magic = 0;
+    free(header);
+}
+
+void alloc_frame_begin() {
+    for (int i = 0; i < site_count; i++) {
+        sites[i].frame_count = 0;
+        sites[i].frame_bytes = 0;
+    }
+    sites[ALLOC_MAX_SITES - 1].frame_count = 0;
+    sites[ALLOC_MAX_SITES - 1].frame_bytes = 0;
+    frame_count = 0;
+    frame_bytes = 0;
+}
+
+int alloc_frame_end() {
+    frames++;
+    return frame_count;
+}
+
+long alloc_frame_bytes() {
+    return frame_bytes;
+}
+
+static const char* site_name(alloc_site_t* site, char* out, size_t size) {
+    if (!site->file) return "other sites";
+    const char* base = strrchr(site->file, '/');
+    snprintf(out, size, "%s:%d", base ? base + 1 : site->file, site->line);
+    return out;
+}
+
+void alloc_frame_report(FILE* out) {
+    char name[128];
+    for (int i = 0; i < ALLOC_MAX_SITES; i++) {
+        if (sites[i].frame_count == 0) continue;
+        fprintf(out, "  %-28s %ld allocations, %ld bytes\n",
+                site_name(&sites[i], name, sizeof(name)), sites[i].frame_count,
+                sites[i].frame_bytes);
+    }
+}
+
+static void alloc_report_at_exit() {
+    char name[128];
+    long leaked_count = 0;
+    long leaked_bytes = 0;
+    fprintf(stderr, "allocations by call site over %ld frames:\n", frames);
+    for (int i = 0; i < ALLOC_MAX_SITES; i++) {
+        alloc_site_t* site = &sites[i];
+        if (site->total_count == 0) continue;
+        fprintf(stderr, "  %-28s %ld allocations (%.2f/frame), %ld bytes (%.0f/frame)",
+                site_name(site, name, sizeof(name)), site->total_count,
+                frames ? (double)site->total_count / frames : 0.0, site->total_bytes,
+                frames ? (double)site->total_bytes / frames : 0.0);
+        if (site->live_count > 0) {
+            fprintf(stderr, ", leaked %ld blocks (%ld bytes)", site->live_count,
+                    site->live_bytes);
+        }
+        fprintf(stderr, "\n");
+        leaked_count += site->live_count;
+        leaked_bytes += site->live_bytes;
+    }
+    fprintf(stderr, "leaked at exit: %ld blocks, %ld bytes\n", leaked_count, leaked_bytes);
+}
+
+#endif // ALLOC_TRACKING
@@ -0,0 +1,46 @@
+#ifndef ALLOC_MODULE_H
+#define ALLOC_MODULE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Opt-in allocation accounting. Built with -DALLOC_TRACKING (and alloc_module.c linked),
+// malloc, calloc, realloc and free in every file that includes this header after the
+// system headers are counted per call site: per frame or tick, in total, and still live.
+// The live blocks are reported as leaks at exit. Without the flag nothing is replaced and
+// the frame functions below do nothing.
+
+#ifdef ALLOC_TRACKING
+
+#define ALLOC_TRACKING_ENABLED 1
+
+void* tracked_malloc(size_t size, const char* file, int line);
+void* tracked_calloc(size_t count, size_t size, const char* file, int line);
+void* tracked_realloc(void* block, size_t size, const char* file, int line);
+void tracked_free(void* block);
+
+// A frame (client, tracer, bench) or tick (server) of the loop being watched
+void alloc_frame_begin();
+int alloc_frame_end(); // allocations made since alloc_frame_begin
+long alloc_frame_bytes();
+void alloc_frame_report(FILE* out); // call sites that allocated in the last frame
+
+#ifndef ALLOC_MODULE_C
+#define malloc(size) tracked_malloc((size), __FILE__, __LINE__)
+#define calloc(count, size) tracked_calloc((count), (size), __FILE__, __LINE__)
+#define realloc(block, size) tracked_realloc((block), (size), __FILE__, __LINE__)
+#define free(block) tracked_free(block)
+#endif
+
+#else
+
+#define ALLOC_TRACKING_ENABLED 0
+
+static inline void alloc_frame_begin() {}
+static inline int alloc_frame_end() { return 0; }
+static inline long alloc_frame_bytes() { return 0; }
+static inline void alloc_frame_report(FILE* out) { (void)out; }
+
+#endif // ALLOC_TRACKING
+
+#endif // ALLOC_MODULE_H
@@ -0,0 +1,43 @@
+#ifndef BENCH_TARGET_H
+#define BENCH_TARGET_H
+
+// A renderer driven by render_bench. Every target builds its own world from the same
+// seed or scene and renders one frame per camera pose without a terminal.
+
+// Scene file voxel types, same values in map_module and the console caster
+#define BENCH_VOID 0
+#define BENCH_OBSTACLE 1
+#define BENCH_MIRROR 2
+
+typedef struct {
+    double x;
+    double y;
+    double z;
+    double angleXY;
+    double angleZY;
+} bench_pose_t;
+
+typedef struct {
+    int x;
+    int y;
+    int z;
+    int type; // BENCH_*
+} bench_voxel_t;
+
+typedef struct {
+    long rays;
+    long steps;   // marching loop iterations
+    long bounces; // mirror reflections
+} bench_counters_t;
+
+typedef struct {
+    const char* name;
+    // Seeded world when `scene` is NULL, otherwise an empty box with the scene's voxels
+    void (*build_world)(unsigned int seed, bench_voxel_t* scene, int scene_count);
+    // Renders one I x J frame and adds the work done to `counters`
+    void (*render_frame)(bench_pose_t* pose, int I, int J, bench_counters_t* counters);
+} bench_target_t;
+
+extern bench_target_t console_target;
+
+#endif // BENCH_TARGET_H
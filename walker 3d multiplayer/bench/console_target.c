@@ -0,0 +1,43 @@
+#include <stdlib.h>
+#include <math.h>
+#include "bench_target.h"
+#include "../../walker 3d console/caster_module.h"
+#include "../alloc_module.h"
+
+// The console walker's 2D caster. It has one ray per screen column, so only J matters,
+// and the scene's z coordinates are ignored.
+
+static void console_build_world(unsigned int seed, bench_voxel_t* scene, int scene_count) {
+    srand(seed);
+    caster_initialize_map();
+    if (!scene) return;
+    for (int i = 1; i < MAP_SIZE - 1; i++) {
+        for (int j = 1; j < MAP_SIZE - 1; j++) {
+            caster_map[i][j] = caster_create_object(VOID_TYPE);
+        }
+    }
+    for (int i = 0; i < scene_count; i++) {
+        if (scene[i].x < 0 || scene[i].x >= MAP_SIZE || scene[i].y < 0 || scene[i].y >= MAP_SIZE) {
+            continue;
+        }
+        caster_map[scene[i].y][scene[i].x] = caster_create_object(scene[i].type);
+    }
+}
+
+static void console_render_frame(bench_pose_t* pose, int I, int J, bench_counters_t* counters) {
+    static char buffer[MAP_SIZE][MAP_SIZE];
+    player_t player;
+    player.x = pose->x;
+    player.y = pose->y;
+    player.angleXY = pose->angleXY;
+    player.color = 0;
+
+    caster_stats_t stats = {0, 0};
+    ray_t* rays = caster_create_rays(&player, buffer, J, &stats);
+    free(rays);
+    counters->rays += J;
+    counters->steps += stats.steps;
+    counters->bounces += stats.bounces;
+}
+
+bench_target_t console_target = {"console", console_build_world, console_render_frame};
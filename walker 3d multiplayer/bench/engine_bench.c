@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../map_module.h"
+#include "../render_module.h"
+#include "../raster_module.h"
+
+// Compares the ray engine and the raster engine on a few fixed scenes. "lean ms" is the ray
+// engine with the debug counters compiled out of the kernel.
+// Usage: engine_bench [LINES COLS [FRAMES]]
+
+#define SCENE_COUNT 4
+#define POSE_COUNT 3
+
+typedef struct {
+    const char* name;
+    void (*build)();
+} scene_t;
+
+void build_empty_scene();
+void build_pillars_scene();
+void build_random_scene();
+void build_mirror_scene();
+double now_ms();
+double run_engine(int engine, int features, player_t* viewer, int I, int J, int frames, rays_list_t* stats);
+
+int main(int argc, char** argv) {
+    int I = 48;
+    int J = 160;
+    int frames = 20;
+    if (argc >= 3) {
+        I = atoi(argv[1]);
+        J = atoi(argv[2]);
+    }
+    if (argc >= 4) {
+        frames = atoi(argv[3]);
+    }
+
+    scene_t scenes[SCENE_COUNT] = {
+        {"empty", build_empty_scene},
+        {"pillars", build_pillars_scene},
+        {"random", build_random_scene},
+        {"mirror", build_mirror_scene},
+    };
+    player_t poses[POSE_COUNT] = {
+        {{12, 19, MAP_HEIGHT / 2}, M_PI / 2, 0, 0},
+        {{20, 5, 4}, M_PI / 4, 0.3, 0},
+        {{35, 35, MAP_HEIGHT - 3}, -3 * M_PI / 4, -0.4, 0},
+    };
+
+    printf("%-8s %-5s %10s %10s %10s %10s %8s\n",
+           "scene", "pose", "rays ms", "lean ms", "raster ms", "speedup", "mirrors");
+    for (int s = 0; s < SCENE_COUNT; s++) {
+        scenes[s].build();
+        for (int p = 0; p < POSE_COUNT; p++) {
+            rays_list_t rays_stats, lean_stats, raster_stats;
+            double rays_ms = run_engine(ENGINE_RAYS, RENDER_ALL, &poses[p], I, J, frames, &rays_stats);
+            double lean_ms = run_engine(ENGINE_RAYS, RENDER_ALL & ~RENDER_DEBUG, &poses[p], I, J,
+                                        frames, &lean_stats);
+            double raster_ms = run_engine(ENGINE_RASTER, RENDER_ALL, &poses[p], I, J, frames,
+                                          &raster_stats);
+            printf("%-8s %-5d %10.3f %10.3f %10.3f %9.2fx %8d\n", scenes[s].name, p,
+                   rays_ms, lean_ms, raster_ms, rays_ms / raster_ms, raster_stats.mirrored_count);
+        }
+    }
+    return 0;
+}
+
+double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Average milliseconds per frame; the first frame is a warm-up (meshing, caches)
+double run_engine(int engine, int features, player_t* viewer, int I, int J, int frames,
+                  rays_list_t* stats) {
+    double total = 0;
+    for (int f = 0; f <= frames; f++) {
+        double start = now_ms();
+        rays_list_t* rays = (engine == ENGINE_RASTER)
+            ? rasterize_frame(viewer, I, J, map, NULL, 0)
+            : create_rays_with(viewer, I, J, map, features);
+        double elapsed = now_ms() - start;
+        if (!rays) {
+            fprintf(stderr, "Failed to render a frame.\n");
+            exit(1);
+        }
+        if (f > 0) total += elapsed;
+        *stats = *rays;
+        free_rays(rays);
+    }
+    return total / frames;
+}
+
+void build_empty_scene() {
+    srand(1);
+    initialize_map();
+}
+
+void build_pillars_scene() {
+    srand(2);
+    initialize_map();
+    for (int y = 5; y < MAP_SIZE - 5; y += 8) {
+        for (int x = 5; x < MAP_SIZE - 5; x += 8) {
+            for (int z = 1; z < MAP_HEIGHT - 1; z++) {
+                map[z][y][x] = create_object(OBSTACLE_TYPE);
+            }
+        }
+    }
+    refresh_map_caches();
+}
+
+void build_random_scene() {
+    srand(3);
+    initialize_map();
+    for (int i = 0; i < 400; i++) {
+        int x = rand() % (MAP_SIZE - 2) + 1;
+        int y = rand() % (MAP_SIZE - 2) + 1;
+        int z = rand() % (MAP_HEIGHT - 2) + 1;
+        map[z][y][x] = create_object(OBSTACLE_TYPE);
+    }
+    refresh_map_caches();
+}
+
+void build_mirror_scene() {
+    srand(4);
+    initialize_map();
+    add_mirror_wall();
+    refresh_map_caches();
+}
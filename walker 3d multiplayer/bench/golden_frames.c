@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../map_module.h"
+#include "../render_module.h"
+#include "../raster_module.h"
+
+// Golden-frame harness. `record` renders the G-buffer of every seed x pose of the corpus
+// with the reference kernel (plain unit-step marcher) into DIR. `compare` renders the same
+// frames with another engine and checks them cell by cell against the files.
+//
+// Usage: golden_frames record [--dir=DIR] [--size=COLSxLINES]
+//        golden_frames compare [--dir=DIR] [--engine=rays|raster|reference]
+//                              [--tolerance=CELLS] [--max-mismatch=FRACTION]
+//                              [--max-error=CELLS] [--heatmap]
+//
+// A cell matches when flags and color are equal and depth is within the tolerance.
+// A frame fails when more than max-mismatch of its cells do not match, or when one cell's
+// depth is off by more than max-error, a ray that went through a wall; the exit code is 1
+// if any frame fails. --heatmap prints every failing frame as text: ' ' matching cell,
+// '0'-'9' depth error in tolerances, 'c' color, 'f' flags.
+
+#define GOLDEN_VERSION 1
+#define GOLDEN_SEEDS 3
+#define GOLDEN_POSES 7
+
+static const char golden_magic[4] = {'W', 'K', 'G', 'B'};
+static const unsigned int golden_seeds[GOLDEN_SEEDS] = {1, 2, 3};
+
+typedef struct {
+    int engine;
+    double tolerance;
+    double max_mismatch;
+    double max_error;
+    bool heatmap;
+} compare_options_t;
+
+#define ENGINE_REFERENCE -1
+
+void build_golden_world(unsigned int seed);
+player_t golden_pose(int pose);
+rays_list_t* render_golden(int engine, player_t* viewer, int I, int J);
+void frame_file_name(char* out, size_t size, const char* dir, unsigned int seed, int pose);
+int write_frame(const char* file_name, rays_list_t* frame);
+rays_list_t* read_frame(const char* file_name);
+int compare_frame(rays_list_t* golden, rays_list_t* frame, compare_options_t* options,
+                  unsigned int seed, int pose);
+
+int main(int argc, char** argv) {
+    if (argc < 2 || (strcmp(argv[1], "record") != 0 && strcmp(argv[1], "compare") != 0)) {
+        fprintf(stderr, "Usage: %s record|compare [--dir=DIR] [--size=COLSxLINES] "
+                        "[--engine=rays|raster|reference] [--tolerance=CELLS] "
+                        "[--max-mismatch=FRACTION] [--max-error=CELLS] [--heatmap]\n", argv[0]);
+        return 1;
+    }
+    bool record = strcmp(argv[1], "record") == 0;
+    const char* dir = "golden";
+    int I = 24;
+    int J = 80;
+    compare_options_t options = {ENGINE_RAYS, 0.5, 0.01, 8, false};
+    for (int i = 2; i < argc; i++) {
+        if (strncmp(argv[i], "--dir=", 6) == 0) {
+            dir = argv[i] + 6;
+        } else if (sscanf(argv[i], "--size=%dx%d", &J, &I) == 2 && I > 0 && J > 0) {
+            continue;
+        } else if (strcmp(argv[i], "--engine=rays") == 0) {
+            options.engine = ENGINE_RAYS;
+        } else if (strcmp(argv[i], "--engine=raster") == 0) {
+            options.engine = ENGINE_RASTER;
+        } else if (strcmp(argv[i], "--engine=reference") == 0) {
+            options.engine = ENGINE_REFERENCE;
+        } else if (sscanf(argv[i], "--tolerance=%lf", &options.tolerance) == 1) {
+            continue;
+        } else if (sscanf(argv[i], "--max-mismatch=%lf", &options.max_mismatch) == 1) {
+            continue;
+        } else if (sscanf(argv[i], "--max-error=%lf", &options.max_error) == 1) {
+            continue;
+        } else if (strcmp(argv[i], "--heatmap") == 0) {
+            options.heatmap = true;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    int failed = 0;
+    char file_name[512];
+    for (int s = 0; s < GOLDEN_SEEDS; s++) {
+        build_golden_world(golden_seeds[s]);
+        for (int p = 0; p < GOLDEN_POSES; p++) {
+            frame_file_name(file_name, sizeof(file_name), dir, golden_seeds[s], p);
+            player_t viewer = golden_pose(p);
+            if (record) {
+                rays_list_t* frame = render_golden(ENGINE_REFERENCE, &viewer, I, J);
+                if (!frame || write_frame(file_name, frame) != 0) return 1;
+                free_rays(frame);
+                continue;
+            }
+            rays_list_t* golden = read_frame(file_name);
+            if (!golden) return 1;
+            rays_list_t* frame = render_golden(options.engine, &viewer, golden->i, golden->j);
+            if (!frame) return 1;
+            failed += compare_frame(golden, frame, &options, golden_seeds[s], p);
+            free_rays(frame);
+            free_rays(golden);
+        }
+    }
+    if (record) {
+        printf("recorded %d frames of %dx%d into %s\n", GOLDEN_SEEDS * GOLDEN_POSES, J, I, dir);
+        return 0;
+    }
+    printf("%d of %d frames failed\n", failed, GOLDEN_SEEDS * GOLDEN_POSES);
+    return failed ? 1 : 0;
+}
+
+// The tracer's world
+void build_golden_world(unsigned int seed) {
+    srand(seed);
+    initialize_map();
+    add_random_obstacles();
+    add_mirror_wall();
+    refresh_map_caches();
+}
+
+// Open space, along and into the mirror wall, looking up and down, far across the map, and
+// straight along x from a cell centre, where the middle ray of an even sized frame steps
+// exactly one cell at a time and lands on cell boundaries
+player_t golden_pose(int pose) {
+    static const double poses[GOLDEN_POSES][5] = {
+        {12, 19, MAP_HEIGHT / 2, M_PI / 2, 0},
+        {5, 17, MAP_HEIGHT / 2, 0.3, 0.1},
+        {30, 25, 8, -M_PI / 2, 0.2},
+        {20, 10, 3, M_PI / 4, 0.6},
+        {20, 30, MAP_HEIGHT - 3, -3 * M_PI / 4, -0.5},
+        {2, 2, MAP_HEIGHT / 2, M_PI / 4, 0},
+        {1.5, 20, 2, 0, 0},
+    };
+    player_t viewer = {{poses[pose][0], poses[pose][1], poses[pose][2]},
+                       poses[pose][3], poses[pose][4], 0};
+    return viewer;
+}
+
+rays_list_t* render_golden(int engine, player_t* viewer, int I, int J) {
+    switch (engine) {
+    case ENGINE_RASTER:
+        return rasterize_frame(viewer, I, J, map, NULL, 0);
+    case ENGINE_RAYS:
+        return create_rays(viewer, I, J, map);
+    default:
+        return create_rays_with(viewer, I, J, map, RENDER_REFERENCE);
+    }
+}
+
+void frame_file_name(char* out, size_t size, const char* dir, unsigned int seed, int pose) {
+    snprintf(out, size, "%s/seed%u_pose%d.gbuf", dir, seed, pose);
+}
+
+// magic, version, I, J, then the depth (native float), flags, color and light planes
+int write_frame(const char* file_name, rays_list_t* frame) {
+    FILE* file = fopen(file_name, "wb");
+    if (!file) {
+        fprintf(stderr, "Cannot create %s\n", file_name);
+        return -1;
+    }
+    int count = frame->i * frame->j;
+    int header[3] = {GOLDEN_VERSION, frame->i, frame->j};
+    fwrite(golden_magic, 1, sizeof(golden_magic), file);
+    fwrite(header, sizeof(int), 3, file);
+    fwrite(frame->depth, sizeof(float), count, file);
+    fwrite(frame->flags, 1, count, file);
+    fwrite(frame->color, 1, count, file);
+    fwrite(frame->light, 1, count, file);
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Failed to write %s\n", file_name);
+        return -1;
+    }
+    return 0;
+}
+
+rays_list_t* read_frame(const char* file_name) {
+    FILE* file = fopen(file_name, "rb");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s, record the golden frames first\n", file_name);
+        return NULL;
+    }
+    char magic[4];
+    int header[3];
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, golden_magic, 4) != 0 ||
+        fread(header, sizeof(int), 3, file) != 3 || header[0] != GOLDEN_VERSION ||
+        header[1] <= 0 || header[2] <= 0) {
+        fprintf(stderr, "%s is not a version %d golden frame\n", file_name, GOLDEN_VERSION);
+        fclose(file);
+        return NULL;
+    }
+    rays_list_t* frame = alloc_rays(header[1], header[2]);
+    if (!frame) {
+        fclose(file);
+        return NULL;
+    }
+    int count = header[1] * header[2];
+    size_t read = fread(frame->depth, sizeof(float), count, file);
+    read += fread(frame->flags, 1, count, file);
+    read += fread(frame->color, 1, count, file);
+    read += fread(frame->light, 1, count, file);
+    fclose(file);
+    if (read != (size_t)count * 4) {
+        fprintf(stderr, "%s is truncated\n", file_name);
+        free_rays(frame);
+        return NULL;
+    }
+    return frame;
+}
+
+// Returns 1 when the frame fails
+int compare_frame(rays_list_t* golden, rays_list_t* frame, compare_options_t* options,
+                  unsigned int seed, int pose) {
+    int count = golden->i * golden->j;
+    char* heatmap = malloc(count);
+    int mismatched = 0;
+    double max_error = 0;
+    for (int c = 0; c < count; c++) {
+        double error = fabs(golden->depth[c] - frame->depth[c]);
+        char cell = ' ';
+        if (golden->flags[c] != frame->flags[c]) {
+            cell = 'f';
+        } else if (!golden->flags[c] && golden->color[c] != frame->color[c]) {
+            cell = 'c';
+        } else if (error > options->tolerance) {
+            int steps = (int)(error / options->tolerance);
+            cell = '0' + (steps > 9 ? 9 : steps);
+        }
+        if (cell != ' ') mismatched++;
+        if (error > max_error) max_error = error;
+        if (heatmap) heatmap[c] = cell;
+    }
+    double fraction = (double)mismatched / count;
+    bool fail = fraction > options->max_mismatch || max_error > options->max_error;
+    printf("seed %u pose %d: %d/%d cells differ (%.2f%%), max depth error %.2f %s\n",
+           seed, pose, mismatched, count, fraction * 100, max_error, fail ? "FAIL" : "ok");
+    if (fail && options->heatmap && heatmap) {
+        for (int i = 0; i < golden->i; i++) {
+            printf("|%.*s|\n", golden->j, heatmap + i * golden->j);
+        }
+    }
+    free(heatmap);
+    return fail;
+}
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../map_module.h"
+#include "../protocol_module.h"
+#include "../snapshot_module.h"
+
+// Text codec (serialize_* / sscanf) against the binary wire messages, for every message
+// the client and server exchange. Prints one JSON object per message and codec with the
+// encoded size and the mean encode and decode time. The world snapshot is measured on
+// the default map with random obstacles and the mirror wall, over fewer iterations. The
+// world state of a full server is measured complete and as a delta in which
+// BENCH_POSITIONS players moved.
+// Usage: protocol_bench [ITERATIONS]
+
+#define BENCH_POSITIONS 8
+#define MAP_ITERATIONS_DIVISOR 50000
+
+typedef struct {
+    const char* message;
+    const char* codec;
+    int bytes;
+    double encode_ns;
+    double decode_ns;
+} codec_result_t;
+
+double now_ns();
+void print_result(codec_result_t* result);
+
+// Keeps the compiler from dropping the decoded values
+static volatile double sink;
+
+int main(int argc, char** argv) {
+    int iterations = argc >= 2 ? atoi(argv[1]) : 200000;
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+        return 1;
+    }
+    player_t player = {{12.345678, 19.5, 10.25}, M_PI / 3, -0.125, 3};
+    position_t positions[BENCH_POSITIONS];
+    for (int i = 0; i < BENCH_POSITIONS; i++) {
+        positions[i] = (position_t){1.5 + i, 30.25 - i, 10 + 0.125 * i};
+    }
+    unsigned char buffer[POSITIONS_MESSAGE_SIZE(PROTOCOL_MAX_PLAYERS)];
+    codec_result_t result;
+    double start;
+
+    // player
+    result = (codec_result_t){"player", "text", 0, 0, 0};
+    start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        char* text = serialize_player(&player);
+        result.bytes = strlen(text);
+        free(text);
+    }
+    result.encode_ns = (now_ns() - start) / iterations;
+    char* player_text = serialize_player(&player);
+    start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        player_t decoded;
+        deserialize_player(player_text, &decoded);
+        sink = decoded.position.x;
+    }
+    result.decode_ns = (now_ns() - start) / iterations;
+    free(player_text);
+    print_result(&result);
+
+    result = (codec_result_t){"player", "binary", 0, 0, 0};
+    start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        result.bytes = encode_player(&player, buffer, sizeof(buffer));
+        sink = buffer[i % PLAYER_MESSAGE_SIZE];
+    }
+    result.encode_ns = (now_ns() - start) / iterations;
+    start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        player_t decoded;
+        decode_player(buffer, result.bytes, &decoded);
+        sink = decoded.position.x;
+    }
+    result.decode_ns = (now_ns() - start) / iterations;
+    print_result(&result);
+
+    // list of positions
+    result = (codec_result_t){"positions", "text", 0, 0, 0};
+    start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        char* text = serialize_positions(positions, BENCH_POSITIONS);
+        result.bytes = strlen(text);
+        free(text);
+    }
+    result.encode_ns = (now_ns() - start) / iterations;
+    char* positions_text = serialize_positions(positions, BENCH_POSITIONS);
+    start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        size_t count;
+        position_t* decoded = deserialize_positions(positions_text, &count);
+        sink = decoded[0].x;
+        free(decoded);
+    }
+    result.decode_ns = (now_ns() - start) / iterations;
+    free(positions_text);
+    print_result(&result);
+
+    result = (codec_result_t){"positions", "binary", 0, 0, 0};
+    start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        result.bytes = encode_positions(positions, BENCH_POSITIONS, buffer, sizeof(buffer));
+        sink = buffer[i % result.bytes];
+    }
+    result.encode_ns = (now_ns() - start) / iterations;
+    start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        position_t decoded[BENCH_POSITIONS];
+        decode_positions(buffer, result.bytes, decoded, BENCH_POSITIONS);
+        sink = decoded[0].x;
+    }
+    result.decode_ns = (now_ns() - start) / iterations;
+    print_result(&result);
+
+    // world state
+    world_state_t state, moved, decoded_state;
+    state.tick = 1;
+    state.own_index = 0;
+    state.input_ack = 0;
+    state.tick_rate = 30;
+    for (int i = 0; i < PROTOCOL_MAX_PLAYERS; i++) {
+        position_t spot = {1.5 + i % 38, 30.25 - i % 29, 10 + 0.125 * i};
+        state.players[i].present = true;
+        quantize_position(&spot, &state.players[i]);
+    }
+    moved = state;
+    moved.tick = 2;
+    for (int i = 0; i < BENCH_POSITIONS; i++) {
+        moved.players[i * 7].x += 13;
+        moved.players[i * 7].y -= 5;
+    }
+    unsigned char state_message[WORLD_STATE_MAX_SIZE];
+    const world_state_t* baselines[] = {NULL, &state};
+    const char* state_codecs[] = {"full", "delta"};
+    for (int b = 0; b < 2; b++) {
+        result = (codec_result_t){"world_state", state_codecs[b], 0, 0, 0};
+        start = now_ns();
+        for (int i = 0; i < iterations; i++) {
+            result.bytes = encode_world_state(&moved, baselines[b], state_message,
+                                              sizeof(state_message));
+            sink = state_message[i % result.bytes];
+        }
+        result.encode_ns = (now_ns() - start) / iterations;
+        start = now_ns();
+        for (int i = 0; i < iterations; i++) {
+            decode_world_state(state_message, result.bytes, baselines[b], &decoded_state);
+            sink = decoded_state.players[7].x;
+        }
+        result.decode_ns = (now_ns() - start) / iterations;
+        print_result(&result);
+    }
+
+    // world
+    srand(1);
+    initialize_map();
+    add_random_obstacles();
+    add_mirror_wall();
+    refresh_map_caches();
+    int map_iterations = iterations / MAP_ITERATIONS_DIVISOR + 1;
+
+    result = (codec_result_t){"map", "text", 0, 0, 0};
+    start = now_ns();
+    for (int i = 0; i < map_iterations; i++) {
+        char* text = serialize_map();
+        result.bytes = strlen(text);
+        free(text);
+    }
+    result.encode_ns = (now_ns() - start) / map_iterations;
+    char* map_text = serialize_map();
+    start = now_ns();
+    for (int i = 0; i < map_iterations; i++) {
+        deserialize_map(map_text);
+    }
+    result.decode_ns = (now_ns() - start) / map_iterations;
+    free(map_text);
+    print_result(&result);
+
+    result = (codec_result_t){"map", "snapshot", 0, 0, 0};
+    unsigned char* snapshot = malloc(SNAPSHOT_MAX_SIZE);
+    start = now_ns();
+    for (int i = 0; i < map_iterations; i++) {
+        result.bytes = encode_map_snapshot(snapshot, SNAPSHOT_MAX_SIZE);
+    }
+    result.encode_ns = (now_ns() - start) / map_iterations;
+    start = now_ns();
+    for (int i = 0; i < map_iterations; i++) {
+        if (decode_map_snapshot(snapshot, result.bytes) < 0) {
+            fprintf(stderr, "Snapshot does not decode\n");
+            return 1;
+        }
+    }
+    result.decode_ns = (now_ns() - start) / map_iterations;
+    free(snapshot);
+    print_result(&result);
+    return 0;
+}
+
+double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+void print_result(codec_result_t* result) {
+    printf("{\"message\": \"%s\", \"codec\": \"%s\", \"bytes\": %d, "
+           "\"encode_ns\": %.1f, \"decode_ns\": %.1f}\n",
+           result->message, result->codec, result->bytes, result->encode_ns,
+           result->decode_ns);
+}
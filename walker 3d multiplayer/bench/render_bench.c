@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../map_module.h"
+#include "../render_module.h"
+#include "../raster_module.h"
+#include "bench_target.h"
+#include "../alloc_module.h"
+
+// Headless renderer benchmark. Builds the world from a seed or a scene file, renders a
+// scripted camera path at a fixed resolution with every selected renderer and prints one
+// JSON object per renderer.
+//
+// Usage: render_bench [--renderer=NAME] [--seed=N] [--scene=FILE] [--path=walk|orbit|FILE]
+//                     [--size=COLSxLINES] [--frames=N] [--fail-on-alloc]
+//
+// Renderers: console, tracer, client-rays, client-raster, all (default).
+// Scene file: one voxel per line, "obstacle X Y Z" or "mirror X Y Z", '#' starts a comment.
+// Path file: one pose per line, "X Y Z ANGLE_XY ANGLE_ZY" with angles in radians.
+//
+// Built with -DALLOC_TRACKING and alloc_module.c, every renderer also reports the
+// allocations of its steady-state frames. --fail-on-alloc then exits with 1, listing the
+// call sites, when any frame after the warm-up allocates.
+
+#define MAX_SCENE_VOXELS (MAP_HEIGHT * MAP_SIZE * MAP_SIZE)
+#define MAX_PATH_POSES 4096
+#define BENCH_PLAYERS 4
+
+typedef struct {
+    bench_pose_t* poses;
+    int count;
+} camera_path_t;
+
+static object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE];
+static position_t bench_players[BENCH_PLAYERS];
+
+void world_build_world(unsigned int seed, bench_voxel_t* scene, int scene_count);
+void client_build_world(unsigned int seed, bench_voxel_t* scene, int scene_count);
+void tracer_render_frame(bench_pose_t* pose, int I, int J, bench_counters_t* counters);
+void client_rays_render_frame(bench_pose_t* pose, int I, int J, bench_counters_t* counters);
+void client_raster_render_frame(bench_pose_t* pose, int I, int J, bench_counters_t* counters);
+
+bench_target_t tracer_target = {"tracer", world_build_world, tracer_render_frame};
+bench_target_t client_rays_target = {"client-rays", client_build_world, client_rays_render_frame};
+bench_target_t client_raster_target = {"client-raster", client_build_world, client_raster_render_frame};
+
+bench_voxel_t* load_scene(const char* file_name, int* count);
+int load_path(const char* name, int frames, camera_path_t* path);
+int run_target(bench_target_t* target, unsigned int seed, const char* scene_name,
+               bench_voxel_t* scene, int scene_count, const char* path_name,
+               camera_path_t* path, int I, int J, bool fail_on_alloc);
+double now_ms();
+int compare_doubles(const void* a, const void* b);
+
+int main(int argc, char** argv) {
+    const char* renderer = "all";
+    unsigned int seed = 1;
+    const char* scene_name = NULL;
+    const char* path_name = "walk";
+    int I = 48;
+    int J = 160;
+    int frames = 120;
+    bool fail_on_alloc = false;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--renderer=", 11) == 0) {
+            renderer = argv[i] + 11;
+        } else if (sscanf(argv[i], "--seed=%u", &seed) == 1) {
+            continue;
+        } else if (strncmp(argv[i], "--scene=", 8) == 0) {
+            scene_name = argv[i] + 8;
+        } else if (strncmp(argv[i], "--path=", 7) == 0) {
+            path_name = argv[i] + 7;
+        } else if (sscanf(argv[i], "--size=%dx%d", &J, &I) == 2 && I > 0 && J > 0) {
+            continue;
+        } else if (sscanf(argv[i], "--frames=%d", &frames) == 1 && frames > 0) {
+            continue;
+        } else if (strcmp(argv[i], "--fail-on-alloc") == 0) {
+            fail_on_alloc = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--renderer=console|tracer|client-rays|client-raster|all] "
+                            "[--seed=N] [--scene=FILE] [--path=walk|orbit|FILE] "
+                            "[--size=COLSxLINES] [--frames=N] [--fail-on-alloc]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (fail_on_alloc && !ALLOC_TRACKING_ENABLED) {
+        fprintf(stderr, "--fail-on-alloc needs a build with -DALLOC_TRACKING\n");
+        return 1;
+    }
+
+    bench_voxel_t* scene = NULL;
+    int scene_count = 0;
+    if (scene_name) {
+        scene = load_scene(scene_name, &scene_count);
+        if (!scene) return 1;
+    }
+    camera_path_t path;
+    if (load_path(path_name, frames, &path) != 0) return 1;
+
+    bench_target_t* targets[] = {&console_target, &tracer_target, &client_rays_target,
+                                 &client_raster_target};
+    int matched = 0;
+    int failed = 0;
+    for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+        if (strcmp(renderer, "all") != 0 && strcmp(renderer, targets[t]->name) != 0) continue;
+        failed += run_target(targets[t], seed, scene_name, scene, scene_count, path_name, &path,
+                             I, J, fail_on_alloc);
+        matched++;
+    }
+    if (!matched) {
+        fprintf(stderr, "Unknown renderer: %s\n", renderer);
+        return 1;
+    }
+    free(path.poses);
+    free(scene);
+    return failed ? 1 : 0;
+}
+
+// Returns 1 when --fail-on-alloc is set and a steady-state frame allocated
+int run_target(bench_target_t* target, unsigned int seed, const char* scene_name,
+               bench_voxel_t* scene, int scene_count, const char* path_name,
+               camera_path_t* path, int I, int J, bool fail_on_alloc) {
+    target->build_world(seed, scene, scene_count);
+
+    // warm-up frame: meshing and caches are not part of the steady state
+    bench_counters_t counters = {0, 0, 0};
+    target->render_frame(&path->poses[0], I, J, &counters);
+
+    double* frame_ms = malloc(sizeof(double) * path->count);
+    if (!frame_ms) {
+        fprintf(stderr, "Failed to allocate frame times.\n");
+        exit(1);
+    }
+    counters = (bench_counters_t){0, 0, 0};
+    double total_ms = 0;
+    long allocations = 0;
+    long allocated_bytes = 0;
+    int allocating_frame = -1;
+    for (int f = 0; f < path->count; f++) {
+        alloc_frame_begin();
+        double start = now_ms();
+        target->render_frame(&path->poses[f], I, J, &counters);
+        frame_ms[f] = now_ms() - start;
+        total_ms += frame_ms[f];
+        int frame_allocations = alloc_frame_end();
+        if (frame_allocations > 0 && allocating_frame < 0) {
+            allocating_frame = f;
+            if (fail_on_alloc) {
+                fprintf(stderr, "%s: frame %d allocated:\n", target->name, f);
+                alloc_frame_report(stderr);
+            }
+        }
+        allocations += frame_allocations;
+        allocated_bytes += alloc_frame_bytes();
+    }
+    qsort(frame_ms, path->count, sizeof(double), compare_doubles);
+    int p99 = (int)ceil(0.99 * path->count) - 1;
+
+    printf("{\"renderer\": \"%s\", ", target->name);
+    if (scene_name) {
+        printf("\"scene\": \"%s\", ", scene_name);
+    } else {
+        printf("\"seed\": %u, ", seed);
+    }
+    printf("\"path\": \"%s\", \"width\": %d, \"height\": %d, \"frames\": %d, ",
+           path_name, J, I, path->count);
+    printf("\"rays\": %ld, \"rays_per_s\": %.0f, \"steps_per_ray\": %.3f, "
+           "\"bounces_per_ray\": %.4f, ",
+           counters.rays, counters.rays / (total_ms / 1000),
+           (double)counters.steps / counters.rays, (double)counters.bounces / counters.rays);
+    if (ALLOC_TRACKING_ENABLED) {
+        printf("\"allocs_per_frame\": %.2f, \"alloc_bytes_per_frame\": %.0f, ",
+               (double)allocations / path->count, (double)allocated_bytes / path->count);
+    }
+    printf("\"frame_ms_mean\": %.4f, \"frame_ms_p50\": %.4f, \"frame_ms_p99\": %.4f}\n",
+           total_ms / path->count, frame_ms[(path->count - 1) / 2], frame_ms[p99]);
+    fflush(stdout);
+    free(frame_ms);
+    return fail_on_alloc && allocating_frame >= 0;
+}
+
+// The tracer's world: random obstacles and the mirror wall
+void world_build_world(unsigned int seed, bench_voxel_t* scene, int scene_count) {
+    srand(seed);
+    initialize_map();
+    if (!scene) {
+        add_random_obstacles();
+        add_mirror_wall();
+    }
+    for (int i = 0; i < scene_count; i++) {
+        if (scene[i].x < 0 || scene[i].x >= MAP_SIZE || scene[i].y < 0 || scene[i].y >= MAP_SIZE ||
+            scene[i].z < 0 || scene[i].z >= MAP_HEIGHT) {
+            continue;
+        }
+        map[scene[i].z][scene[i].y][scene[i].x] = create_object(scene[i].type);
+    }
+    refresh_map_caches();
+}
+
+// Same world with a few other players standing in empty cells
+void client_build_world(unsigned int seed, bench_voxel_t* scene, int scene_count) {
+    world_build_world(seed, scene, scene_count);
+    for (int i = 0; i < BENCH_PLAYERS; i++) {
+        int x, y, z;
+        do {
+            x = rand() % (MAP_SIZE - 2) + 1;
+            y = rand() % (MAP_SIZE - 2) + 1;
+            z = rand() % (MAP_HEIGHT - 2) + 1;
+        } while (map[z][y][x].type != VOID_TYPE);
+        bench_players[i].x = x;
+        bench_players[i].y = y;
+        bench_players[i].z = z;
+    }
+}
+
+static player_t pose_viewer(bench_pose_t* pose) {
+    player_t viewer = {{pose->x, pose->y, pose->z}, pose->angleXY, pose->angleZY, 0};
+    return viewer;
+}
+
+static void add_rays_counters(rays_list_t* rays, bench_counters_t* counters) {
+    if (!rays) {
+        fprintf(stderr, "Failed to render a frame.\n");
+        exit(1);
+    }
+    counters->rays += (long)rays->i * rays->j;
+    counters->steps += rays->steps_counter;
+    counters->bounces += rays->mirrored_count;
+    free_rays(rays);
+}
+
+void tracer_render_frame(bench_pose_t* pose, int I, int J, bench_counters_t* counters) {
+    player_t viewer = pose_viewer(pose);
+    add_rays_counters(create_rays_with(&viewer, I, J, map, RENDER_ALL), counters);
+}
+
+void client_rays_render_frame(bench_pose_t* pose, int I, int J, bench_counters_t* counters) {
+    player_t viewer = pose_viewer(pose);
+    copy_map_with_players(map_with_players_added, bench_players, BENCH_PLAYERS);
+    add_rays_counters(create_rays_with(&viewer, I, J, map_with_players_added, RENDER_ALL),
+                      counters);
+}
+
+void client_raster_render_frame(bench_pose_t* pose, int I, int J, bench_counters_t* counters) {
+    player_t viewer = pose_viewer(pose);
+    copy_map_with_players(map_with_players_added, bench_players, BENCH_PLAYERS);
+    add_rays_counters(rasterize_frame(&viewer, I, J, map_with_players_added,
+                                      bench_players, BENCH_PLAYERS), counters);
+}
+
+bench_voxel_t* load_scene(const char* file_name, int* count) {
+    FILE* file = fopen(file_name, "r");
+    if (!file) {
+        fprintf(stderr, "Cannot open scene file %s\n", file_name);
+        return NULL;
+    }
+    bench_voxel_t* scene = malloc(sizeof(bench_voxel_t) * MAX_SCENE_VOXELS);
+    if (!scene) {
+        fclose(file);
+        return NULL;
+    }
+    char line[128];
+    char type[16];
+    *count = 0;
+    while (fgets(line, sizeof(line), file) && *count < MAX_SCENE_VOXELS) {
+        bench_voxel_t* voxel = &scene[*count];
+        if (line[0] == '#' || sscanf(line, "%15s %d %d %d", type, &voxel->x, &voxel->y, &voxel->z) != 4) {
+            continue;
+        }
+        if (strcmp(type, "obstacle") == 0) {
+            voxel->type = BENCH_OBSTACLE;
+        } else if (strcmp(type, "mirror") == 0) {
+            voxel->type = BENCH_MIRROR;
+        } else if (strcmp(type, "void") == 0) {
+            voxel->type = BENCH_VOID;
+        } else {
+            fprintf(stderr, "Unknown voxel type in scene: %s\n", type);
+            continue;
+        }
+        (*count)++;
+    }
+    fclose(file);
+    return scene;
+}
+
+// Built-in paths: "walk" goes along the mirror wall looking left and right,
+// "orbit" turns around in the middle of the map while nodding
+int load_path(const char* name, int frames, camera_path_t* path) {
+    if (strcmp(name, "walk") == 0 || strcmp(name, "orbit") == 0) {
+        path->poses = malloc(sizeof(bench_pose_t) * frames);
+        if (!path->poses) return -1;
+        path->count = frames;
+        for (int f = 0; f < frames; f++) {
+            double t = (double)f / frames;
+            bench_pose_t* pose = &path->poses[f];
+            if (name[0] == 'w') {
+                pose->x = 3 + t * (MAP_SIZE - 7);
+                pose->y = 18;
+                pose->z = MAP_HEIGHT / 2;
+                pose->angleXY = M_PI / 2 + 0.8 * sin(4 * M_PI * t);
+                pose->angleZY = 0.1 * sin(2 * M_PI * t);
+            } else {
+                pose->x = MAP_SIZE / 2;
+                pose->y = MAP_SIZE / 2 - 6;
+                pose->z = MAP_HEIGHT / 2;
+                pose->angleXY = 2 * M_PI * t;
+                pose->angleZY = 0.3 * sin(6 * M_PI * t);
+            }
+        }
+        return 0;
+    }
+
+    FILE* file = fopen(name, "r");
+    if (!file) {
+        fprintf(stderr, "Cannot open path file %s\n", name);
+        return -1;
+    }
+    path->poses = malloc(sizeof(bench_pose_t) * MAX_PATH_POSES);
+    if (!path->poses) {
+        fclose(file);
+        return -1;
+    }
+    path->count = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file) && path->count < MAX_PATH_POSES) {
+        bench_pose_t* pose = &path->poses[path->count];
+        if (sscanf(line, "%lf %lf %lf %lf %lf", &pose->x, &pose->y, &pose->z,
+                   &pose->angleXY, &pose->angleZY) == 5) {
+            path->count++;
+        }
+    }
+    fclose(file);
+    if (path->count == 0) {
+        fprintf(stderr, "No poses in path file %s\n", name);
+        return -1;
+    }
+    return 0;
+}
+
+double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+int compare_doubles(const void* a, const void* b) {
+    double difference = *(const double*)a - *(const double*)b;
+    return (difference > 0) - (difference < 0);
+}
@@ -8,20 +8,27 @@
 #include <stdbool.h>
 #include <enet/enet.h>
 #include <string.h>  // For memcpy, memset
+#include <poll.h>
+#include <errno.h>
 #include "../map_module.h"
-
-#define PLAYER_AVATAR '@'
-#define OBSTACLE '#'
-#define MIRROR 'M'
-#define MINIMAP_HEIGHT 20
-#define MINIMAP_WIDTH 36
+#include "../render_module.h"
+#include "../raster_module.h"
+#include "../view_module.h"
+#include "../profile_module.h"
+#include "../latency_module.h"
+#include "../interpolation_module.h"
+#include "../protocol_module.h"
+#include "../movement_module.h"
+#include "../snapshot_module.h"
+#include "../world_cache_module.h"
+#include "../alloc_module.h"
 
 #define CHANEL_COUNT 64
+#define PROFILE_DUMP_KEY 'P' // writes the --profile trace now
+#define WORLD_UPDATED_KEY 0  // not a key: wait_for_input saw the world change, redraw
+#define REMOTE_FRAME_MS 33   // redraw interval while other players move
+#define SPAWN_TIMEOUT_MS 5000
 
-const double max_ray_lenght = MAP_SIZE * 2;
-const double HEIGHT_ANGLE = M_PI / 4;
-const double VIEW_ANGLE = M_PI / 2;
-const double CAMERA_SPEED = M_PI / 24;
 const double brightnest_level = 5;
 
 const int OUTCOME_MAP_UPDATES_CHANEL = 0;
@@ -30,33 +37,14 @@ const int OUTCOME_LIST_OF_PLAYERS_CHANEL = 3;
 const int OUTCOME_NEW_PLAYER_POSITION = 4;
 
 const int INCOME_PLAYER_UPDATED_CHANEL = 2;
+const int INCOME_VOXEL_EDITS_CHANEL = 5;
+const int INCOME_RESYNC_CHANEL = 6;
+const int INCOME_STATE_ACK_CHANEL = 7;
 
 int CURRENT_ID;
-
-typedef struct ray {
-    double end_x;
-    double end_y;
-    double end_z;
-    int index;
-    double lenght;
-    bool is_player;
-    int color;
-} ray_t;
-
-typedef struct rays_list {
-    ray_t* rays;
-    int i;
-    int j;
-    int mirrored_count;
-    int rays_into_walls_counter;
-    int rays_into_player_counter;
-    int rays_to_long_counter;
-} rays_list_t;
-
-typedef struct frame {
-    char buffer[MAP_SIZE][MAP_SIZE];
-    rays_list_t* rays;
-} frame_t;
+int render_engine = ENGINE_RAYS;
+int render_features = RENDER_ALL;
+shade_table_t shade_table;
 
 typedef struct server_init_response {
     object_t map[MAP_HEIGHT][MAP_SIZE][MAP_SIZE];
@@ -66,36 +54,121 @@ typedef struct server_init_response {
 } server_init_response_t;
 
 player_t* this_player;
-position_t* other_players;
+bool player_received = false;
+position_t other_players[PROTOCOL_MAX_PLAYERS];
 int player_count;
+// tick of the newest world state applied, states that are not newer are dropped
+int world_tick = 0;
+bool world_tick_known = false;
+// states received, by tick % WORLD_STATE_HISTORY, the baselines of the next ones
+world_state_t received_states[WORLD_STATE_HISTORY];
+// positions of the other players by index, `other_players` is sampled from them per frame
+position_buffer_t remote_players[PROTOCOL_MAX_PLAYERS];
+tick_clock_t state_clock;
+double state_period_ms = 0; // of the server's ticks, 0 before the first state
+double remote_sampled_ms = 0; // when `other_players` was last sampled
+
+// version of the server's world the local map matches, from snapshots and deltas
+unsigned int world_version = 0;
+bool world_received = false; // a snapshot arrived, before it world_version means nothing
+bool resync_requested = false; // hashes sent after losing edits, waiting for the chunks
+// cached worlds of this server: loaded before joining, saved after every snapshot and at exit
+const char* world_cache_dir = NULL;
+char world_server[96]; // IP-PORT
+// edits made since the last send; applied locally at once, the server's delta confirms them
+voxel_edit_t pending_edits[MAX_VOXEL_EDITS];
+int pending_edit_count = 0;
+// Movement is predicted: a command moves this_player at once and stays pending, and is
+// resent, until a world state acknowledges it. The state's position of this player plus
+// the pending commands replayed on it is where the player is.
+input_command_t pending_commands[INPUT_COMMANDS_MAX];
+int pending_command_count = 0;
+int next_command_sequence = 1; // the server acknowledges 0 before the first command
+
+// key read -> frame with its effect flushed, and command sent -> server acknowledgement
+latency_stats_t input_latency;
+latency_stats_t echo_latency;
+echo_tracker_t echo_tracker;
+FILE* latency_log = NULL;
+// oldest key whose effect has not reached the terminal yet, -1 when none
+double input_read_ms = -1;
+int input_latency_key;
 
 void pull_server_updates(ENetHost* client, ENetPeer* peer, int timeout, bool with_logs);
 
-void init_ncyrses();
-void enable_raw_mode();
-void disable_raw_mode();
 void init_player(player_t* player);
-frame_t create_frame(bool write_map);
+frame_t create_frame();
 void update_player(int input);
-rays_list_t* create_rays(char buffer[MAP_SIZE][MAP_SIZE],
-                         object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE]);
-void draw_frame(frame_t* frame);
-char get_wall_char(ray_t* ray);
-bool wall_collision(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
-                    double pos_x, double pos_y, double pos_z);
-bool mirror_collision(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
-                      double pos_x, double pos_y, double pos_z);
-bool player_colision(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
-                     double pos_x, double pos_y, double pos_z);
-int sign(int a);
-int min_int(int a, int b);
-int max_int(int a, int b);
-void render_minimap(frame_t* frame, bool frame_color);
+void receive_map_update(ENetPacket* packet, ENetPeer* peer);
+void receive_world_state(ENetPacket* packet, ENetPeer* peer);
+void request_resync(ENetPeer* peer);
+void request_chunks(ENetPacket* hashes, ENetPeer* peer);
+void save_world();
+void reconcile_player(const player_state_t* own, int input_ack);
+int sample_remote_players(position_t* players);
+bool remote_players_moved();
+void send_input_commands(ENetPeer* peer);
 void send_data_to_server(ENetPeer* peer, ENetHost* client);
+int wait_for_input(ENetHost* client, ENetPeer* peer);
+void wait_for_spawn(ENetHost* client, ENetPeer* peer);
+void record_latency(latency_stats_t* stats, const char* kind, int key, double ms);
+void show_latency_stats();
+void input_shown();
 ENetPeer* init_connection(ENetHost* client);
 ENetHost* init_enet();
 
-int main() {
+int main(int argc, char** argv) {
+    const char* ramp = DEFAULT_SHADE_RAMP;
+    double fog_start = NO_FOG;
+    double fog_end = NO_FOG;
+    const char* profile_name = NULL;
+    const char* latency_log_name = NULL;
+    world_cache_dir = default_world_cache_dir();
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--engine=raster") == 0) {
+            render_engine = ENGINE_RASTER;
+        } else if (strcmp(argv[i], "--engine=rays") == 0) {
+            render_engine = ENGINE_RAYS;
+        } else if (strncmp(argv[i], "--ramp=", 7) == 0 && argv[i][7] != '\0') {
+            ramp = argv[i] + 7;
+        } else if (sscanf(argv[i], "--fog=%lf:%lf", &fog_start, &fog_end) == 2) {
+            continue;
+        } else if (strcmp(argv[i], "--no-stats") == 0) {
+            render_features &= ~RENDER_DEBUG;
+        } else if (strncmp(argv[i], "--profile=", 10) == 0) {
+            profile_name = argv[i] + 10;
+        } else if (strncmp(argv[i], "--latency-log=", 14) == 0) {
+            latency_log_name = argv[i] + 14;
+        } else if (strncmp(argv[i], "--world-cache=", 14) == 0 && argv[i][14] != '\0') {
+            world_cache_dir = argv[i] + 14;
+        } else if (strcmp(argv[i], "--no-world-cache") == 0) {
+            world_cache_dir = NULL;
+        } else {
+            fprintf(stderr, "Usage: %s [--engine=rays|--engine=raster] [--ramp=CHARS] [--fog=START:END] [--no-stats] [--profile=TRACE_JSON] [--latency-log=CSV] [--world-cache=DIR|--no-world-cache]\n", argv[0]);
+            return 1;
+        }
+    }
+    build_shade_table(&shade_table, ramp, brightnest_level, fog_start, fog_end, 0);
+    profile_enable(profile_name != NULL);
+    latency_reset(&input_latency);
+    latency_reset(&echo_latency);
+    echo_reset(&echo_tracker);
+    for (int i = 0; i < WORLD_STATE_HISTORY; i++) {
+        received_states[i].tick = -1;
+    }
+    for (int i = 0; i < PROTOCOL_MAX_PLAYERS; i++) {
+        position_buffer_reset(&remote_players[i]);
+    }
+    tick_clock_reset(&state_clock);
+    if (latency_log_name) {
+        latency_log = fopen(latency_log_name, "w");
+        if (!latency_log) {
+            fprintf(stderr, "Cannot create latency log %s\n", latency_log_name);
+            return 1;
+        }
+        fprintf(latency_log, "kind,key,ms\n");
+    }
+
     ENetHost* client = init_enet();
     if (client == NULL) return 1;
 
@@ -106,26 +179,57 @@ int main() {
 
     enable_raw_mode();
     init_ncyrses();
+    enable_frame_pacing();
 
     this_player = malloc(sizeof(player_t));
+    init_player(this_player);
     int input = 'x';
-    pull_server_updates(client, peer, 1000, true);
+    wait_for_spawn(client, peer);
     do {
+        PROFILE_SPAN("frame");
+        alloc_frame_begin();
         // printf("Pulling server updates\n");
         // printf("Creating frame\n");
-        frame_t frame = create_frame(false);
+        frame_t frame = create_frame();
         // printf("Frame created\n");
-        draw_frame(&frame);
+        show_latency_stats();
+        if (draw_frame(&frame, this_player, &shade_table, render_features & RENDER_DEBUG)) {
+            input_shown();
+        }
 
-        pull_server_updates(client, peer, 0, true);
-        input = getchar();
-        update_player(input);
+        {
+            PROFILE_SPAN("wait for input");
+            input = wait_for_input(client, peer);
+            if (input == WORLD_UPDATED_KEY) {
+                free_rays(frame.rays);
+                alloc_frame_end();
+                continue;
+            }
+            if (input_read_ms < 0) {
+                input_read_ms = latency_clock_ms();
+                input_latency_key = input;
+            }
+        }
+        if (input == PROFILE_DUMP_KEY && profile_name) {
+            profile_export_chrome(profile_name, "client");
+        } else if (!handle_view_key(input, &frame)) {
+            update_player(input);
+        }
         send_data_to_server(peer, client);
 
-        free(frame.rays->rays);
-        free(frame.rays);
-
+        free_rays(frame.rays);
+        alloc_frame_end();
     } while (input != 'x');
+    if (profile_name) profile_export_chrome(profile_name, "client");
+    save_world();
+    if (latency_log) {
+        char line[96];
+        latency_format(&input_latency, "input", line, sizeof(line));
+        fprintf(latency_log, "# %s\n", line);
+        latency_format(&echo_latency, "echo", line, sizeof(line));
+        fprintf(latency_log, "# %s\n", line);
+        fclose(latency_log);
+    }
 
     enet_peer_disconnect(peer, 0);
     {
@@ -170,7 +274,15 @@ ENetPeer* init_connection(ENetHost* client) {
     enet_address_set_host(&address, server_ip);
     address.port = port;
 
-    ENetPeer* peer = enet_host_connect(client, &address, CHANEL_COUNT, 0);
+    snprintf(world_server, sizeof(world_server), "%s-%d", server_ip, port);
+    bool cached_world = world_cache_dir && load_cached_world(world_cache_dir, world_server);
+    if (cached_world) {
+        printf("Using the cached world of %s\n", world_server);
+    } else {
+        fill_map_with_fog();
+    }
+    ENetPeer* peer = enet_host_connect(client, &address, CHANEL_COUNT,
+                                       cached_world ? JOIN_WITH_HASHES : 0);
     if (!peer) {
         fprintf(stderr, "No available peers for initiating an ENet connection.\n");
         return NULL;
@@ -180,6 +292,7 @@ ENetPeer* init_connection(ENetHost* client) {
     if (enet_host_service(client, &event, 5000) > 0 &&
         event.type == ENET_EVENT_TYPE_CONNECT) {
         printf("Connection to server succeeded.\n");
+        if (cached_world) request_resync(peer);
     } else {
         enet_peer_reset(peer);
         fprintf(stderr, "Connection to server failed.\n");
@@ -197,38 +310,27 @@ void print_server_data(ENetEvent* event) {
 }
 
 void pull_server_updates(ENetHost* client, ENetPeer* peer, int timeout, bool with_logs) {
+    PROFILE_SPAN("pull_server_updates");
     ENetEvent event;
     while (enet_host_service(client, &event, timeout) > 0) {
         switch (event.type) {
             case ENET_EVENT_TYPE_RECEIVE: {
                 switch (event.channelID) {
                     case OUTCOME_MAP_UPDATES_CHANEL: {
-                        // printf("%s:\n", event.packet->data);
-                        deserialize_map(event.packet->data);
-                        if (with_logs) {
-                            for (int k = 0; k < MAP_HEIGHT; k++) {
-                                printf("Recieved map data, Z-level %d:\n", k);
-                                for (int i = 0; i < MAP_SIZE; i++) {
-                                    for (int j = 0; j < MAP_SIZE; j++) {
-                                        // printf("|%c, %d, %d|", map[1][i][j].symbol, map[1][i][j].color, map[1][i][j].type);
-                                        printf("%c", map[k][i][j].symbol);
-                                    }
-                                    printf("\n");
-                                }
-                                printf("\n");
-                            }
-                        }
+                        receive_map_update(event.packet, peer);
                         break;
                     }
                     case OUTCOME_NEW_PLAYER_CHANEL: {
                         if (with_logs) {
                             printf("Recieve current player\n");
-                            printf("%s\n", event.packet->data);
                         }
-                        if (deserialize_player(event.packet->data, this_player) == 0 && with_logs) {
-                            printf("Deserialized player: |%lf|%lf|%lf|%lf|%lf|%d",
-                                this_player->position.x, this_player->position.y, this_player->position.z,
-                                this_player->angleXY, this_player->angleZY, this_player->color);
+                        if (decode_player(event.packet->data, event.packet->dataLength, this_player) == 0) {
+                            player_received = true;
+                            if (with_logs) {
+                                printf("Deserialized player: |%lf|%lf|%lf|%lf|%lf|%d",
+                                    this_player->position.x, this_player->position.y, this_player->position.z,
+                                    this_player->angleXY, this_player->angleZY, this_player->color);
+                            }
                         }
                         break;
                     }
@@ -236,7 +338,10 @@ void pull_server_updates(ENetHost* client, ENetPeer* peer, int timeout, bool wit
                         if (with_logs) {
                             printf("recieve list of other players\n");
                         }
-                        other_players = deserialize_positions(event.packet->data, &player_count);
+                        int count = decode_positions(event.packet->data, event.packet->dataLength,
+                                                     other_players, PROTOCOL_MAX_PLAYERS);
+                        if (count < 0) break;
+                        player_count = count;
 
                         if (with_logs) {
                             printf("first player: %f, %f, %f\n", other_players[0].x, other_players[0].y, other_players[0].z );
@@ -245,24 +350,7 @@ void pull_server_updates(ENetHost* client, ENetPeer* peer, int timeout, bool wit
                         break;
                     }
                     case OUTCOME_NEW_PLAYER_POSITION: {
-                        // TOOD: 
-                        if (with_logs) {
-                            // printf("recieve player updated pos: %s\n", event.packet->data);
-                            mvprintw(LINES - OUTCOME_NEW_PLAYER_POSITION, COLS / 2 - 10, "A player changed position to: %s <- with id ",
-                                    event.packet->data);
-                            refresh();
-                        }
-                        player_position_t* new_player_pos = malloc(sizeof(player_position_t));
-                        deserialize_player_positions(event.packet->data, new_player_pos);
-
-                        position_t position;
-                        position.x = new_player_pos->x;
-                        position.y = new_player_pos->y;
-                        position.z = new_player_pos->z;
-                        if (true || new_player_pos->index != 0) {
-                            other_players[new_player_pos->index] = position;
-                            free(new_player_pos);
-                        }
+                        receive_world_state(event.packet, peer);
                         break;
                     }
                     default:
@@ -307,396 +395,330 @@ void pull_server_updates(ENetHost* client, ENetPeer* peer, int timeout, bool wit
     }
 }
 
-void init_ncyrses() {
-    initscr();
-    cbreak();
-    noecho();
-    keypad(stdscr, TRUE);
-    start_color();
-    init_pair(0, COLOR_BLACK, COLOR_BLACK);
-    init_pair(1, COLOR_RED, COLOR_BLACK);
-    init_pair(2, COLOR_GREEN, COLOR_BLACK);
-    init_pair(3, COLOR_BLUE, COLOR_BLACK);
-    init_pair(4, COLOR_YELLOW, COLOR_BLACK);
-    init_pair(5, COLOR_MAGENTA, COLOR_BLACK);
-    init_pair(6, COLOR_CYAN, COLOR_BLACK);
-    init_pair(7, COLOR_WHITE, COLOR_BLACK);
-}
-
-void enable_raw_mode() {
-    struct termios t;
-    tcgetattr(STDIN_FILENO, &t);
-    t.c_lflag &= ~(ICANON | ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &t);
-}
-
-void disable_raw_mode() {
-    struct termios t;
-    tcgetattr(STDIN_FILENO, &t);
-    t.c_lflag |= (ICANON | ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &t);
-}
-
-void init_player(player_t* player) {
-    position_t position;
-    position.x = 12;
-    position.y = 19;
-    position.z = MAP_HEIGHT / 2;
-    player->position = position;
-    player->angleXY = M_PI / 2;
-    player->angleZY = 0;
-    player->color = COLOR_BLACK;
-}
-
-void update_player(int input) {
-    double cos_ = cos(this_player->angleXY) * cos(this_player->angleZY);
-    double sin_ = sin(this_player->angleXY);
-    switch (input) {
-    case 'd':
-        if (!wall_collision(map, this_player->position.x - sin_,
-                            this_player->position.y + cos_,
-                            this_player->position.z)) {
-            this_player->position.y += cos_;
-            this_player->position.x -= sin_;
-        }
-        break;
-    case 'w':
-        if (!wall_collision(map, this_player->position.x + cos_,
-                            this_player->position.y + sin_,
-                            this_player->position.z)) {
-            this_player->position.y += sin_;
-            this_player->position.x += cos_;
+// A world snapshot, a delta of edits or the chunk hashes of a resync, all ordered on the
+// map channel
+void receive_map_update(ENetPacket* packet, ENetPeer* peer) {
+    PROFILE_SPAN("receive map update");
+    switch (message_type(packet->data, packet->dataLength)) {
+    case MESSAGE_MAP_SNAPSHOT: {
+        long version = decode_map_snapshot(packet->data, packet->dataLength);
+        if (version < 0) {
+            fprintf(stderr, "Malformed world snapshot of %zu bytes\n", packet->dataLength);
+            break;
         }
+        world_version = version;
+        world_received = true;
+        resync_requested = false;
+        save_world();
         break;
-    case 'a':
-        if (!wall_collision(map, this_player->position.x + sin_,
-                            this_player->position.y - cos_,
-                            this_player->position.z)) {
-            this_player->position.y -= cos_;
-            this_player->position.x += sin_;
-        }
-        break;
-    case 's':
-        if (!wall_collision(map, this_player->position.y - sin_,
-                            this_player->position.x - cos_,
-                            this_player->position.z)) {
-            this_player->position.y -= sin_;
-            this_player->position.x -= cos_;
-        }
-        break;
-    case 'e':
-        if (this_player->position.z < MAP_HEIGHT - 1) {
-            this_player->position.z += 1;
+    }
+    case MESSAGE_MAP_DELTA: {
+        unsigned int base, version;
+        voxel_edit_t edits[MAX_VOXEL_EDITS];
+        int count = decode_map_delta(packet->data, packet->dataLength, &base, &version, edits,
+                                     MAX_VOXEL_EDITS);
+        if (count < 0) break;
+        // a delta older than the snapshot only repeats edits it already has, which is
+        // harmless as edits set absolute values; a newer base means edits were lost.
+        // Before the first snapshot the world is still on its way and nothing is lost.
+        if (world_received && base > world_version && !resync_requested) {
+            request_resync(peer);
         }
-        break;
-    case 'q':
-        if (this_player->position.z > 1) {
-            this_player->position.z -= 1;
+        for (int i = 0; i < count; i++) {
+            apply_voxel_edit(&edits[i]);
         }
+        world_version = version;
         break;
-    case 68:
-        this_player->angleXY -= CAMERA_SPEED;
-        break;
-    case 67:
-        this_player->angleXY += CAMERA_SPEED;
-        break;
-    case 65:
-        this_player->angleZY -= CAMERA_SPEED;
-        break;
-    case 66:
-        this_player->angleZY += CAMERA_SPEED;
-        break;
-    case 'p':
-        map[(int)this_player->position.z]
-           [(int)this_player->position.y]
-           [(int)this_player->position.x] = create_object(OBSTACLE_TYPE);
+    }
+    case MESSAGE_CHUNK_HASHES:
+        request_chunks(packet, peer);
         break;
     default:
         break;
     }
 }
 
-void send_data_to_server(ENetPeer* peer, ENetHost* client) {
-    char* serialized_player = serialize_player(this_player);
-    ENetPacket* packet = enet_packet_create(serialized_player,
-                                            strlen(serialized_player),
-                                            ENET_PACKET_FLAG_RELIABLE);
-    enet_peer_send(peer, INCOME_PLAYER_UPDATED_CHANEL, packet);
-    enet_host_flush(client);
+// All players as of one server tick, applied on the baseline it names and acknowledged.
+// The others go into their interpolation buffers, the own slot corrects this_player.
+void receive_world_state(ENetPacket* packet, ENetPeer* peer) {
+    PROFILE_SPAN("receive world state");
+    int baseline_tick = world_state_baseline(packet->data, packet->dataLength);
+    world_state_t* baseline = NULL;
+    if (baseline_tick >= 0) {
+        baseline = &received_states[baseline_tick % WORLD_STATE_HISTORY];
+        if (baseline->tick != baseline_tick) return; // never acknowledged, cannot happen
+    }
+    world_state_t state;
+    if (decode_world_state(packet->data, packet->dataLength, baseline, &state) != 0) return;
+    if (world_tick_known && !sequence_newer(state.tick, world_tick)) {
+        return; // overtaken by a newer state
+    }
+    world_tick = state.tick;
+    world_tick_known = true;
+    received_states[state.tick % WORLD_STATE_HISTORY] = state;
+
+    unsigned char ack[STATE_ACK_MESSAGE_SIZE];
+    encode_state_ack(state.tick, ack, sizeof(ack));
+    enet_peer_send(peer, INCOME_STATE_ACK_CHANEL, enet_packet_create(ack, sizeof(ack), 0));
+
+    state_period_ms = 1000.0 / state.tick_rate;
+    double time_ms = tick_clock_add(&state_clock, state.tick, state_period_ms,
+                                    latency_clock_ms());
+    for (int i = 0; i < PROTOCOL_MAX_PLAYERS; i++) {
+        if (state.players[i].present && i != state.own_index) {
+            position_t position = player_state_position(&state.players[i]);
+            position_buffer_push(&remote_players[i], time_ms, &position);
+        } else {
+            position_buffer_reset(&remote_players[i]);
+        }
+    }
+
+    double echo_ms = echo_received(&echo_tracker, (const unsigned char*)&state.input_ack,
+                                   sizeof(state.input_ack), latency_clock_ms());
+    if (echo_ms >= 0) record_latency(&echo_latency, "echo", 0, echo_ms);
+    if (player_received && state.players[state.own_index].present) {
+        reconcile_player(&state.players[state.own_index], state.input_ack);
+    }
+    // commands lost on the way are resent until acknowledged
+    if (pending_command_count > 0) send_input_commands(peer);
 }
 
-frame_t create_frame(bool write_map) {
-    // printf("\n Entered create_frame");
-    char buffer[MAP_SIZE][MAP_SIZE];
-    for (int i = 0; i < MAP_SIZE; i++) {
-        for (int j = 0; j < MAP_SIZE; j++) {
-            buffer[i][j] = map[(int)this_player->position.z][i][j].symbol;
+// The other players as they were INTERPOLATION_DELAY_TICKS ago, returns their count
+int sample_remote_players(position_t* players) {
+    if (state_period_ms <= 0) return 0;
+    double time_ms = tick_clock_now(&state_clock, latency_clock_ms()) -
+                     INTERPOLATION_DELAY_TICKS * state_period_ms;
+    int count = 0;
+    for (int i = 0; i < PROTOCOL_MAX_PLAYERS; i++) {
+        if (position_buffer_sample(&remote_players[i], time_ms,
+                                   EXTRAPOLATION_MAX_TICKS * state_period_ms, &players[count])) {
+            count++;
         }
     }
-    // printf("\n Created buffer");
-    object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE];
-    memcpy(map_with_players_added, map, sizeof(map));
-    for (int i = 0; i < player_count; i++) {
-        object_t another_player;
-        another_player.type = PLAYER_TYPE;
-        another_player.symbol = OBSTACLE_SYMBOL;
-        another_player.color = COLOR_BLACK;
-        map_with_players_added[(int)other_players[i].z]
-                              [(int)other_players[i].y]
-                              [(int)other_players[i].x] = another_player;
-    }
-    // printf("\n Created map_with_players_added");
-    rays_list_t* rays = create_rays(buffer, map_with_players_added);
-    // printf("\n Casted rays");
-    buffer[(int)this_player->position.y][(int)this_player->position.x] = PLAYER_AVATAR;
-
-    if (write_map) {
-        for (int i = 0; i < MAP_SIZE; i++) {
-            for (int j = 0; j < MAP_SIZE; j++) {
-                putchar(buffer[i][j]);
-            }
-            putchar('\n');
+    return count;
+}
+
+// Whether the other players are somewhere else than in the last frame
+bool remote_players_moved() {
+    position_t players[PROTOCOL_MAX_PLAYERS];
+    int count = sample_remote_players(players);
+    if (count != player_count) return true;
+    for (int i = 0; i < count; i++) {
+        if (players[i].x != other_players[i].x || players[i].y != other_players[i].y ||
+            players[i].z != other_players[i].z) {
+            return true;
         }
     }
-    frame_t frame;
-    for (size_t i = 0; i < MAP_SIZE; i++) {
-        for (size_t j = 0; j < MAP_SIZE; j++) {
-            frame.buffer[i][j] = buffer[i][j];
+    return false;
+}
+
+// Drops the commands the server ran and replays the others on its position. The view stays
+// as it is, it went through the same commands.
+void reconcile_player(const player_state_t* own, int input_ack) {
+    int kept = 0;
+    for (int i = 0; i < pending_command_count; i++) {
+        if (sequence_newer(pending_commands[i].sequence, input_ack)) {
+            pending_commands[kept++] = pending_commands[i];
         }
     }
-    frame.rays = rays;
-    return frame;
+    pending_command_count = kept;
+
+    double angleXY = this_player->angleXY;
+    double angleZY = this_player->angleZY;
+    this_player->position = player_state_position(own);
+    for (int i = 0; i < pending_command_count; i++) {
+        apply_input(this_player, &pending_commands[i]);
+    }
+    this_player->angleXY = angleXY;
+    this_player->angleZY = angleZY;
+}
+
+// Sends the map's root and subtree hashes, the server answers with its chunk hashes under
+// the subtrees that differ
+void request_resync(ENetPeer* peer) {
+    unsigned char request[RESYNC_REQUEST_SIZE];
+    int size = encode_resync_request(request, sizeof(request));
+    ENetPacket* packet = enet_packet_create(request, size, ENET_PACKET_FLAG_RELIABLE);
+    enet_peer_send(peer, INCOME_RESYNC_CHANEL, packet);
+    resync_requested = true;
 }
 
-bool wall_collision(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
-                    double pos_x, double pos_y, double pos_z) {
-    int type = map_to_use[(int)(pos_z)][(int)(pos_y)][(int)(pos_x)].type;
-    return (type == PLAYER_TYPE || type == OBSTACLE_TYPE);
+// Asks for the chunks whose hashes differ from the server's, the snapshot of them ends the
+// resync
+void request_chunks(ENetPacket* hashes, ENetPeer* peer) {
+    int chunks[MAP_CHUNK_COUNT];
+    int count = differing_chunks(hashes->data, hashes->dataLength, chunks, MAP_CHUNK_COUNT);
+    if (count < 0) {
+        fprintf(stderr, "Malformed chunk hashes of %zu bytes\n", hashes->dataLength);
+        return;
+    }
+    unsigned char request[CHUNK_REQUEST_SIZE(MAP_CHUNK_COUNT)];
+    int size = encode_chunk_request(chunks, count, request, sizeof(request));
+    ENetPacket* packet = enet_packet_create(request, size, ENET_PACKET_FLAG_RELIABLE);
+    enet_peer_send(peer, INCOME_RESYNC_CHANEL, packet);
 }
 
-bool mirror_collision(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
-                      double pos_x, double pos_y, double pos_z) {
-    return map_to_use[(int)(pos_z)][(int)(pos_y)][(int)(pos_x)].type == MIRROR_TYPE;
+void save_world() {
+    if (world_cache_dir && world_version > 0 && !map_has_fog() &&
+        !save_cached_world(world_cache_dir, world_server, world_version)) {
+        fprintf(stderr, "Cannot cache the world in %s\n", world_cache_dir);
+    }
 }
 
-bool player_colision(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
-                     double pos_x, double pos_y, double pos_z) {
-    return map_to_use[(int)(pos_z)][(int)(pos_y)][(int)(pos_x)].type == PLAYER_TYPE;
+void init_player(player_t* player) {
+    position_t position;
+    position.x = 12;
+    position.y = 19;
+    position.z = MAP_HEIGHT / 2;
+    player->position = position;
+    player->angleXY = M_PI / 2;
+    player->angleZY = 0;
+    player->color = COLOR_BLACK;
 }
 
-rays_list_t* create_rays(char buffer[MAP_SIZE][MAP_SIZE],
-                         object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE]) {
-    int I = LINES;
-    int J = COLS;
-    ray_t* rays = malloc(sizeof(ray_t) * (I * J));
-    if (!rays) return NULL;
-
-    int mirrored_count = 0;
-    int rays_into_walls_counter = 0;
-    int rays_into_player_counter = 0;
-    int rays_to_long_counter = 0;
-
-    for (int i = 0; i < I; i++) {
-        double ZY_angle = -HEIGHT_ANGLE / 2 + (((double)i + 1) / (double)I) * HEIGHT_ANGLE + this_player->angleZY;
-        for (int j = 0; j < J; j++) {
-            double XY_angle = -VIEW_ANGLE / 2 + (((double)j + 1) / (double)J) * VIEW_ANGLE + this_player->angleXY;
-            double x = this_player->position.x + 0.5;
-            double y = this_player->position.y + 0.5;
-            double z = this_player->position.z + 0.5;
-            double dx = 0, dy = 0, dz = 0;
-            double total_distance = 0;
-            int dx_dir = 1, dy_dir = 1, dz_dir = 1;
-            ray_t ray;
-            ray.index = i * J + j;
-            ray.is_player = false;
-            bool is_reflected = false;
-            while (true) {
-                if (total_distance > max_ray_lenght) {
-                    rays_to_long_counter++;
-                    ray.color = COLOR_WHITE;
-                    break;
-                } else if (wall_collision(map_with_players_added, x, y, z)) {
-                    rays_into_walls_counter++;
-                    ray.color = map_with_players_added[(int)z][(int)y][(int)x].color;
-                    break;
-                } else if (is_reflected && player_colision(map_with_players_added, x, y, z)) {
-                    ray.is_player = true;
-                    rays_into_player_counter++;
-                    ray.color = this_player->color;
-                    break;
-                } else if (mirror_collision(map_with_players_added, x, y, z)) {
-                    is_reflected = true;
-                    double prev_x = x - dx;
-                    double prev_y = y - dy;
-                    double prev_z = z - dz;
-                    if (mirror_collision(map_with_players_added, prev_x + dx, prev_y, prev_z)) dx_dir *= -1;
-                    if (mirror_collision(map_with_players_added, prev_x, prev_y + dy, prev_z)) dy_dir *= -1;
-                    if (mirror_collision(map_with_players_added, prev_x, prev_y, prev_z + dz)) dz_dir *= -1;
-                    mirrored_count++;
-                }
-                dx = cos(ZY_angle) * cos(XY_angle) * dx_dir;
-                dy = cos(ZY_angle) * sin(XY_angle) * dy_dir;
-                dz = sin(ZY_angle) * dz_dir;
-                total_distance += 1;
-                x += dx;
-                y += dy;
-                z += dz;
-            }
-            ray.end_x = x;
-            ray.end_y = y;
-            ray.end_z = z;
-            ray.lenght = total_distance;
-            rays[ray.index] = ray;
+void update_player(int input) {
+    if (input == 'p') {
+        voxel_edit_t edit;
+        edit.x = (int)this_player->position.x;
+        edit.y = (int)this_player->position.y;
+        edit.z = (int)this_player->position.z;
+        edit.type = OBSTACLE_TYPE;
+        edit.color = create_object(OBSTACLE_TYPE).color;
+        if (apply_voxel_edit(&edit) && pending_edit_count < MAX_VOXEL_EDITS) {
+            pending_edits[pending_edit_count++] = edit;
         }
+        return;
     }
-    double view_x = this_player->position.x;
-    double view_y = this_player->position.y;
-    double dx = cos(this_player->angleXY);
-    double dy = sin(this_player->angleXY);
-    while (map_with_players_added[(int)this_player->position.z]
-                                 [(int)(view_y + dy)]
-                                 [(int)(view_x + dx)].type == VOID_TYPE) {
-        buffer[(int)(view_y + dy)][(int)(view_x + dx)] = '^';
-        view_x += dx;
-        view_y += dy;
-    }
-    rays_list_t* list = malloc(sizeof(rays_list_t));
-    if (!list) {
-        free(rays);
-        return NULL;
+    if (!is_movement_key(input)) return;
+
+    input_command_t command;
+    command.sequence = next_command_sequence++ & 0xffff;
+    command.key = input;
+    // the view as the server gets it
+    command.angleXY = (float)this_player->angleXY;
+    command.angleZY = (float)this_player->angleZY;
+    apply_input(this_player, &command);
+    if (pending_command_count == INPUT_COMMANDS_MAX) {
+        // the server is that far behind, the oldest is given up and corrected later
+        memmove(pending_commands, pending_commands + 1,
+                (INPUT_COMMANDS_MAX - 1) * sizeof(input_command_t));
+        pending_command_count--;
     }
-    list->rays = rays;
-    list->i = I;
-    list->j = J;
-    list->mirrored_count = mirrored_count;
-    list->rays_into_player_counter = rays_into_player_counter;
-    list->rays_into_walls_counter = rays_into_walls_counter;
-    list->rays_to_long_counter = rays_to_long_counter;
-    return list;
+    pending_commands[pending_command_count++] = command;
+    echo_sent(&echo_tracker, (const unsigned char*)&command.sequence, sizeof(command.sequence),
+              latency_clock_ms());
 }
 
-void draw_frame(frame_t* frame) {
-    clear();
-    ray_t* rays = frame->rays->rays;
-    int I = frame->rays->i;
-    int J = frame->rays->j;
-    render_minimap(frame, true);
-    int start_for_stats_on_screen = LINES * 0.80;
-    for (int i = 0; i < I; i++) {
-        for (int j = 0; j < J; j++) {
-            ray_t current_ray = rays[i * J + j];
-            int color = current_ray.color;
-            char wall = get_wall_char(&current_ray);
-            attron(COLOR_PAIR(color));
-            mvaddch(i, j, wall);
-            attroff(COLOR_PAIR(color));
-        }
-    }
-    mvprintw(start_for_stats_on_screen, COLS * 0.8,
-             "X: %f Y: %f", this_player->position.x, this_player->position.y);
-    mvprintw(start_for_stats_on_screen + 1, COLS * 0.8,
-             "angle XY %f", this_player->angleXY / M_PI * 180);
-    mvprintw(start_for_stats_on_screen + 2, COLS * 0.8,
-             "angle ZY %f", this_player->angleZY / M_PI * 180);
-    mvprintw(start_for_stats_on_screen + 3, COLS * 0.8,
-             "Position Z %f", this_player->position.z);
-    mvprintw(start_for_stats_on_screen + 4, COLS * 0.8, "I %d", I);
-    mvprintw(start_for_stats_on_screen + 5, COLS * 0.8, "J %d", J);
-    mvprintw(start_for_stats_on_screen + 6, COLS * 0.8,
-             "into walls %d", frame->rays->rays_into_walls_counter);
-    mvprintw(start_for_stats_on_screen + 7, COLS * 0.8,
-             "into player %d", frame->rays->rays_into_player_counter);
-    mvprintw(start_for_stats_on_screen + 8, COLS * 0.8,
-             "mirrored %d", frame->rays->mirrored_count);
-    mvprintw(start_for_stats_on_screen + 9, COLS * 0.8,
-             "too long %d", frame->rays->rays_to_long_counter);
-    render_minimap(frame, true);
-    refresh();
+// All pending commands, oldest first
+void send_input_commands(ENetPeer* peer) {
+    unsigned char message[INPUT_COMMANDS_MESSAGE_SIZE(INPUT_COMMANDS_MAX)];
+    int message_size = encode_input_commands(pending_commands, pending_command_count, message,
+                                             sizeof(message));
+    // unreliable: the commands travel again with every send until acknowledged, so a lost
+    // message needs no resend of its own
+    ENetPacket* packet = enet_packet_create(message, message_size, 0);
+    enet_peer_send(peer, INCOME_PLAYER_UPDATED_CHANEL, packet);
 }
 
-void render_minimap(frame_t* frame, bool frame_color) {
-    int minimap_width = min_int(MINIMAP_WIDTH, MAP_SIZE);
-    int minimap_height = min_int(MINIMAP_HEIGHT, MAP_SIZE);
-    int start_i = 0;
-    if (this_player->position.y + minimap_height / 2 > MAP_SIZE) {
-        start_i = MAP_SIZE - minimap_height;
-    } else {
-        start_i = max_int(this_player->position.y - minimap_height / 2, 0);
-    }
-    int end_i = 0;
-    if (this_player->position.y - minimap_height / 2 < 0) {
-        end_i = minimap_height;
-    } else {
-        end_i = min_int(minimap_height / 2 + this_player->position.y, MAP_SIZE);
+void send_data_to_server(ENetPeer* peer, ENetHost* client) {
+    PROFILE_SPAN("send_data_to_server");
+    if (pending_command_count > 0) send_input_commands(peer);
+    if (pending_edit_count > 0) {
+        unsigned char edits_message[VOXEL_EDITS_MESSAGE_SIZE(MAX_VOXEL_EDITS)];
+        int edits_size = encode_voxel_edits(pending_edits, pending_edit_count, edits_message,
+                                            sizeof(edits_message));
+        pending_edit_count = 0;
+        ENetPacket* edits_packet = enet_packet_create(edits_message, edits_size,
+                                                      ENET_PACKET_FLAG_RELIABLE);
+        enet_peer_send(peer, INCOME_VOXEL_EDITS_CHANEL, edits_packet);
     }
-    int start_j = 0;
-    if (this_player->position.x + minimap_width / 2 > MAP_SIZE) {
-        start_j = MAP_SIZE - minimap_width;
-    } else {
-        start_j = max_int(this_player->position.x - minimap_width / 2, 0);
+    enet_host_flush(client);
+}
+
+// The first frame needs only the player, the world streams in while it plays
+void wait_for_spawn(ENetHost* client, ENetPeer* peer) {
+    PROFILE_SPAN("wait for spawn");
+    double start = latency_clock_ms();
+    while (!player_received && latency_clock_ms() - start < SPAWN_TIMEOUT_MS) {
+        pull_server_updates(client, peer, 10, true);
     }
-    int end_j = 0;
-    if (this_player->position.x - minimap_width / 2 < 0) {
-        end_j = minimap_width;
-    } else {
-        end_j = min_int(minimap_width / 2 + this_player->position.x, MAP_SIZE);
-    }
-    int z = (int)(this_player->position.z);
-    for (int i = start_i; i < end_i; i++) {
-        for (int j = start_j; j < end_j; j++) {
-            if (frame_color && frame->buffer[i][j] == '#') {
-                char color_type;
-                if (map[0][i][j].color == COLOR_BLACK) {
-                    continue;
-                } else if (map[z][i][j].color == COLOR_RED) {
-                    color_type = 'R';
-                } else if (map[z][i][j].color == COLOR_GREEN) {
-                    color_type = 'G';
-                } else if (map[z][i][j].color == COLOR_YELLOW) {
-                    color_type = 'Y';
-                } else if (map[z][i][j].color == COLOR_BLUE) {
-                    color_type = 'b';
-                } else if (map[z][i][j].color == COLOR_MAGENTA) {
-                    color_type = 'M';
-                } else if (map[z][i][j].color == COLOR_CYAN) {
-                    color_type = 'C';
-                } else if (map[z][i][j].color == COLOR_WHITE) {
-                    color_type = 'W';
-                } else {
-                    color_type = '#';
-                }
-                mvaddch(i - start_i, j - start_j + COLS - MINIMAP_WIDTH, color_type);
-            } else {
-                mvaddch(i - start_i, j - start_j + COLS - MINIMAP_WIDTH,
-                        frame->buffer[i][j]);
-            }
+}
+
+// Services the connection until a key arrives, so echoes are timed when they come in,
+// and sends a frame held back by frame pacing once the terminal has drained.
+// Returns WORLD_UPDATED_KEY instead when chunks or edits changed the map, or every
+// REMOTE_FRAME_MS while other players move.
+int wait_for_input(ENetHost* client, ENetPeer* peer) {
+    struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {client->socket, POLLIN, 0}};
+    unsigned int shown_version = map_version;
+    pull_server_updates(client, peer, 0, false);
+    while (true) {
+        double remote_wait_ms = REMOTE_FRAME_MS - (latency_clock_ms() - remote_sampled_ms);
+        if (map_version != shown_version || (remote_wait_ms <= 0 && remote_players_moved())) {
+            return WORLD_UPDATED_KEY;
+        }
+        int timeout_ms = pending_frame_retry_ms();
+        if (player_count > 0) {
+            int remote_ms = remote_wait_ms > 0 ? (int)ceil(remote_wait_ms) : REMOTE_FRAME_MS;
+            if (timeout_ms < 0 || timeout_ms > remote_ms) timeout_ms = remote_ms;
+        }
+        int ready = poll(fds, 2, timeout_ms);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready <= 0) {
+            if (present_pending_frame()) input_shown();
+            continue;
         }
+        if (fds[0].revents & (POLLIN | POLLHUP)) {
+            // read() rather than getchar(): stdio would buffer the rest of an escape
+            // sequence where poll() cannot see it
+            unsigned char key;
+            return read(STDIN_FILENO, &key, 1) == 1 ? key : 'x';
+        }
+        pull_server_updates(client, peer, 0, false);
     }
+    return 'x';
 }
 
-char get_wall_char(ray_t* ray) {
-    if (ray->end_z < 1 || ray->end_z > MAP_HEIGHT - 1) {
-        return '^';
-    }
-    if (ray->is_player) {
-        return '#';
-    }
-    char bightnes[10] = {'@', '%', '*', ';', '+', '=', '-', ':', '.', ' '};
-    int index = ray->lenght / brightnest_level;
-    if (index >= (int)sizeof(bightnes)) {
-        return ' ';
-    }
-    return bightnes[index];
+void record_latency(latency_stats_t* stats, const char* kind, int key, double ms) {
+    latency_add(stats, ms);
+    if (latency_log) fprintf(latency_log, "%s,%d,%.3f\n", kind, key, ms);
 }
 
-int sign(int a) {
-    return (a > 0) - (a < 0);
+// The frame with the pending key's effect has been flushed to the terminal
+void input_shown() {
+    if (input_read_ms < 0) return;
+    record_latency(&input_latency, "input", input_latency_key, latency_clock_ms() - input_read_ms);
+    input_read_ms = -1;
 }
 
-int min_int(int a, int b) {
-    return (a < b) ? a : b;
+void show_latency_stats() {
+    char line[96];
+    latency_format(&input_latency, "input", line, sizeof(line));
+    set_extra_stat(0, line);
+    latency_format(&echo_latency, "echo", line, sizeof(line));
+    set_extra_stat(1, line);
 }
 
-int max_int(int a, int b) {
-    return (a > b) ? a : b;
+frame_t create_frame() {
+    PROFILE_SPAN("create_frame");
+    frame_t frame;
+    object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE];
+    player_count = sample_remote_players(other_players);
+    remote_sampled_ms = latency_clock_ms();
+    {
+        PROFILE_SPAN("copy_map_with_players");
+        copy_map_with_players(map_with_players_added, other_players, player_count);
+    }
+    if (render_engine == ENGINE_RASTER) {
+        PROFILE_SPAN("rasterize_frame");
+        frame.rays = rasterize_frame(this_player, LINES, COLS, map_with_players_added,
+                                     other_players, player_count);
+    } else {
+        PROFILE_SPAN("create_rays");
+        int features = render_features | (cost_overlay ? RENDER_COST : 0);
+        frame.rays = create_rays_with(this_player, LINES, COLS, map_with_players_added,
+                                      features);
+    }
+    fill_minimap(&frame, this_player, map_with_players_added);
+    return frame;
 }
@@ -9,70 +9,7 @@
 #include <enet/enet.h>
 #include <string.h>  // For memcpy, memset
 
-#define MAP_SIZE 40
-#define MAP_HEIGHT 20
-#define PLAYER_AVATAR '@'
-#define OBSTACLE '#'
-#define MIRROR 'M'
-#define MINIMAP_HEIGHT 20
-#define MINIMAP_WIDTH 36
-
-const double max_ray_lenght = MAP_SIZE * 2;
-const double HEIGHT_ANGLE = M_PI / 4;
-const double VIEW_ANGLE = M_PI / 2;
-const double CAMERA_SPEED = M_PI / 24;
-const double brightnest_level = 5;
-
-typedef struct object {
-    int color;
-    int type;
-    char symbol;
-} object_t;
-
-typedef struct position {
-    double x;
-    double y;
-    double z;
-} position_t;
-
-typedef struct other_player_position {
-    double x;
-    double y;
-    double z;
-    int index;
-} player_position_t;
-
-typedef struct player {
-    position_t position;
-    double angleXY;
-    double angleZY;
-    int color;
-} player_t;
-
-typedef struct ray {
-    double end_x;
-    double end_y;
-    double end_z;
-    int index;
-    double lenght;
-    bool is_player;
-    int color;
-} ray_t;
-
-typedef struct rays_list {
-    ray_t* rays;
-    int i;
-    int j;
-    int mirrored_count;
-    int rays_into_walls_counter;
-    int rays_into_player_counter;
-    int rays_to_long_counter;
-} rays_list_t;
-
-typedef struct frame {
-    char buffer[MAP_SIZE][MAP_SIZE];
-    rays_list_t* rays;
-} frame_t;
+#include "../map_module.h"
 
 typedef struct server_init_response {
     object_t map[MAP_HEIGHT][MAP_SIZE][MAP_SIZE];
@@ -81,16 +18,6 @@ typedef struct server_init_response {
     player_t player;
 } server_init_response_t;
 
-const int VOID_TYPE = 0;
-const int OBSTACLE_TYPE = 1;
-const int MIRROR_TYPE = 2;
-const int PLAYER_TYPE = 3;
-
-const char OBSTACLE_SYMBOL = '#';
-const char MIRROR_SYMBOL = 'M';
-const char EMPTY_SYMBOL = ' ';
-
-static object_t map[MAP_HEIGHT][MAP_SIZE][MAP_SIZE];
 player_t* this_player;
 position_t other_players[64];
 int player_count;
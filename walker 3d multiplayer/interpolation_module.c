@@ -0,0 +1,86 @@
+#include "interpolation_module.h"
+#include <math.h>
+
+static const timed_position_t* sample_at(const position_buffer_t* buffer, int i) {
+    return &buffer->samples[(buffer->first + i) % INTERPOLATION_SAMPLES];
+}
+
+static position_t lerp(const timed_position_t* a, const timed_position_t* b, double time_ms) {
+    double t = (time_ms - a->time_ms) / (b->time_ms - a->time_ms);
+    position_t position;
+    position.x = a->position.x + (b->position.x - a->position.x) * t;
+    position.y = a->position.y + (b->position.y - a->position.y) * t;
+    position.z = a->position.z + (b->position.z - a->position.z) * t;
+    return position;
+}
+
+// inside the map, an extrapolated player may run past its edge
+static double clamp(double value, double limit) {
+    if (value < 0) return 0;
+    if (value >= limit) return limit - 1e-9;
+    return value;
+}
+
+void position_buffer_reset(position_buffer_t* buffer) {
+    buffer->first = 0;
+    buffer->count = 0;
+}
+
+void position_buffer_push(position_buffer_t* buffer, double time_ms, const position_t* position) {
+    if (buffer->count > 0 && time_ms <= sample_at(buffer, buffer->count - 1)->time_ms) return;
+    if (buffer->count == INTERPOLATION_SAMPLES) {
+        buffer->first = (buffer->first + 1) % INTERPOLATION_SAMPLES;
+        buffer->count--;
+    }
+    timed_position_t* sample =
+        &buffer->samples[(buffer->first + buffer->count) % INTERPOLATION_SAMPLES];
+    sample->time_ms = time_ms;
+    sample->position = *position;
+    buffer->count++;
+}
+
+bool position_buffer_sample(const position_buffer_t* buffer, double time_ms,
+                            double extrapolate_ms, position_t* position) {
+    if (buffer->count == 0) return false;
+    const timed_position_t* newest = sample_at(buffer, buffer->count - 1);
+    if (time_ms >= newest->time_ms) {
+        *position = newest->position;
+        if (buffer->count > 1) {
+            double ahead = fmin(time_ms - newest->time_ms, extrapolate_ms);
+            *position = lerp(sample_at(buffer, buffer->count - 2), newest,
+                             newest->time_ms + ahead);
+        }
+    } else if (time_ms <= sample_at(buffer, 0)->time_ms) {
+        *position = sample_at(buffer, 0)->position;
+    } else {
+        int i = buffer->count - 2;
+        while (sample_at(buffer, i)->time_ms > time_ms) i--;
+        *position = lerp(sample_at(buffer, i), sample_at(buffer, i + 1), time_ms);
+    }
+    position->x = clamp(position->x, MAP_SIZE);
+    position->y = clamp(position->y, MAP_SIZE);
+    position->z = clamp(position->z, MAP_HEIGHT);
+    return true;
+}
+
+void tick_clock_reset(tick_clock_t* clock) {
+    clock->started = false;
+}
+
+double tick_clock_add(tick_clock_t* clock, int tick, double period_ms, double received_ms) {
+    if (!clock->started) {
+        clock->started = true;
+        clock->ticks = 0;
+        clock->zero_ms = received_ms;
+    } else {
+        clock->ticks += (tick - clock->last_tick) & 0xffff;
+    }
+    clock->last_tick = tick;
+    double time_ms = clock->ticks * period_ms;
+    clock->zero_ms = fmin(clock->zero_ms + TICK_CLOCK_DRIFT_MS, received_ms - time_ms);
+    return time_ms;
+}
+
+double tick_clock_now(const tick_clock_t* clock, double now_ms) {
+    return now_ms - clock->zero_ms;
+}
@@ -0,0 +1,53 @@
+#ifndef INTERPOLATION_MODULE_H
+#define INTERPOLATION_MODULE_H
+
+#include <stdbool.h>
+#include "map_module.h"
+
+// Remote players are drawn a few ticks in the past, between the world states around that
+// moment, so they move smoothly whatever the network timing. States are placed on the
+// server's tick grid rather than at their arrival, which carries the jitter.
+
+#define INTERPOLATION_SAMPLES 16
+#define INTERPOLATION_DELAY_TICKS 3 // a lost state still leaves one on either side
+#define EXTRAPOLATION_MAX_TICKS 3   // past the newest state, then the player holds still
+#define TICK_CLOCK_DRIFT_MS 0.05    // per state, lets the clock follow a slower route
+
+typedef struct {
+    double time_ms;
+    position_t position;
+} timed_position_t;
+
+// Newest positions of one player, in time order from `first`
+typedef struct {
+    timed_position_t samples[INTERPOLATION_SAMPLES];
+    int first;
+    int count;
+} position_buffer_t;
+
+// Server ticks on the local clock. Tick times count from tick 0 in tick periods, and
+// `zero_ms` is the local time of tick 0 as the earliest arrival puts it: later arrivals
+// were held up on the way.
+typedef struct {
+    bool started;
+    int last_tick;
+    long ticks; // unwrapped last_tick
+    double zero_ms;
+} tick_clock_t;
+
+void position_buffer_reset(position_buffer_t* buffer);
+// Samples not newer than the newest one are ignored
+void position_buffer_push(position_buffer_t* buffer, double time_ms, const position_t* position);
+// The position at `time_ms`, interpolated between the samples around it, extrapolated from
+// the last two for at most `extrapolate_ms` past the newest and kept inside the map.
+// False when the buffer is empty.
+bool position_buffer_sample(const position_buffer_t* buffer, double time_ms,
+                            double extrapolate_ms, position_t* position);
+
+void tick_clock_reset(tick_clock_t* clock);
+// Time of `tick`, newer than the last one, received at local `received_ms`
+double tick_clock_add(tick_clock_t* clock, int tick, double period_ms, double received_ms);
+// Local `now_ms` in tick time
+double tick_clock_now(const tick_clock_t* clock, double now_ms);
+
+#endif // INTERPOLATION_MODULE_H
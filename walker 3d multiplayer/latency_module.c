@@ -0,0 +1,84 @@
+#include "latency_module.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+double latency_clock_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+void latency_reset(latency_stats_t* stats) {
+    stats->next = 0;
+    stats->count = 0;
+    stats->total = 0;
+}
+
+void latency_add(latency_stats_t* stats, double ms) {
+    stats->samples[stats->next] = ms;
+    stats->next = (stats->next + 1) % LATENCY_WINDOW;
+    if (stats->count < LATENCY_WINDOW) stats->count++;
+    stats->total++;
+}
+
+static int compare_samples(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+double latency_percentile(const latency_stats_t* stats, double percent) {
+    if (stats->count == 0) return 0;
+    double sorted[LATENCY_WINDOW];
+    memcpy(sorted, stats->samples, sizeof(double) * stats->count);
+    qsort(sorted, stats->count, sizeof(double), compare_samples);
+    int index = (int)(percent / 100 * stats->count + 0.5) - 1;
+    if (index < 0) index = 0;
+    if (index >= stats->count) index = stats->count - 1;
+    return sorted[index];
+}
+
+void latency_format(const latency_stats_t* stats, const char* name, char* out, size_t size) {
+    if (stats->count == 0) {
+        snprintf(out, size, "%s -", name);
+        return;
+    }
+    snprintf(out, size, "%s p50 %.1f p95 %.1f p99 %.1f ms (%ld)", name,
+             latency_percentile(stats, 50), latency_percentile(stats, 95),
+             latency_percentile(stats, 99), stats->total);
+}
+
+void echo_reset(echo_tracker_t* tracker) {
+    tracker->first = 0;
+    tracker->count = 0;
+}
+
+void echo_sent(echo_tracker_t* tracker, const unsigned char* key, int size, double now_ms) {
+    if (size > ECHO_KEY_SIZE) size = ECHO_KEY_SIZE;
+    if (tracker->count == ECHO_PENDING) {
+        tracker->first = (tracker->first + 1) % ECHO_PENDING; // forget the oldest
+        tracker->count--;
+    }
+    int slot = (tracker->first + tracker->count) % ECHO_PENDING;
+    memcpy(tracker->keys[slot], key, size);
+    tracker->key_sizes[slot] = size;
+    tracker->sent_ms[slot] = now_ms;
+    tracker->count++;
+}
+
+double echo_received(echo_tracker_t* tracker, const unsigned char* key, int size,
+                     double now_ms) {
+    if (size > ECHO_KEY_SIZE) size = ECHO_KEY_SIZE;
+    for (int i = 0; i < tracker->count; i++) {
+        int slot = (tracker->first + i) % ECHO_PENDING;
+        if (tracker->key_sizes[slot] != size || memcmp(tracker->keys[slot], key, size) != 0) {
+            continue;
+        }
+        double ms = now_ms - tracker->sent_ms[slot];
+        tracker->first = (slot + 1) % ECHO_PENDING;
+        tracker->count -= i + 1;
+        return ms;
+    }
+    return -1;
+}
@@ -0,0 +1,43 @@
+#ifndef LATENCY_MODULE_H
+#define LATENCY_MODULE_H
+
+#include <stdio.h>
+
+// Latency samples in milliseconds. Percentiles cover the last LATENCY_WINDOW samples.
+
+#define LATENCY_WINDOW 256
+
+typedef struct {
+    double samples[LATENCY_WINDOW];
+    int next;
+    int count; // samples in the window
+    long total; // samples ever added
+} latency_stats_t;
+
+double latency_clock_ms();
+void latency_reset(latency_stats_t* stats);
+void latency_add(latency_stats_t* stats, double ms);
+double latency_percentile(const latency_stats_t* stats, double percent); // 0 when empty
+// "NAME p50 X p95 Y p99 Z ms (N)" or "NAME -" when empty
+void latency_format(const latency_stats_t* stats, const char* name, char* out, size_t size);
+
+// Sent positions waiting for the server's echo, matched on the encoded position bytes
+#define ECHO_PENDING 64
+#define ECHO_KEY_SIZE 16
+
+typedef struct {
+    unsigned char keys[ECHO_PENDING][ECHO_KEY_SIZE];
+    int key_sizes[ECHO_PENDING];
+    double sent_ms[ECHO_PENDING];
+    int first;
+    int count;
+} echo_tracker_t;
+
+void echo_reset(echo_tracker_t* tracker);
+void echo_sent(echo_tracker_t* tracker, const unsigned char* key, int size, double now_ms);
+// Milliseconds since the matching send, or -1 when the message echoes nothing pending.
+// Older pending sends are dropped, their echoes were lost or merged.
+double echo_received(echo_tracker_t* tracker, const unsigned char* key, int size,
+                     double now_ms);
+
+#endif // LATENCY_MODULE_H
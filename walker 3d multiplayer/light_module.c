@@ -0,0 +1,90 @@
+#include "light_module.h"
+
+unsigned char light_volume[MAP_HEIGHT][MAP_SIZE][MAP_SIZE][6];
+
+// Faces looking up get the most light, faces looking down the least
+static const double face_weight[6] = {0.8, 0.8, 0.9, 0.9, 0.6, 1.0};
+
+static bool light_blocked(int x, int y, int z) {
+    if (x < 0 || x >= MAP_SIZE || y < 0 || y >= MAP_SIZE || z < 0 || z >= MAP_HEIGHT) {
+        return true;
+    }
+    int type = map[z][y][x].type;
+    return type == OBSTACLE_TYPE || type == MIRROR_TYPE;
+}
+
+static unsigned char bake_face(int x, int y, int z, int face) {
+    if (map[z][y][x].type != OBSTACLE_TYPE) {
+        return LIGHT_FULL;
+    }
+    int axis = face / 2;
+    int normal = (face & 1) ? 1 : -1;
+    int n[3] = {x, y, z};
+    n[axis] += normal;
+    if (light_blocked(n[0], n[1], n[2])) {
+        return LIGHT_FULL; // hidden face
+    }
+
+    // ambient occlusion: the 8 cells around the one in front of the face
+    int u_axis = (axis == 0) ? 1 : 0;
+    int v_axis = (axis == 2) ? 1 : 2;
+    int occluded = 0;
+    for (int a = -1; a <= 1; a++) {
+        for (int b = -1; b <= 1; b++) {
+            if (a == 0 && b == 0) continue;
+            int c[3] = {n[0], n[1], n[2]};
+            c[u_axis] += a;
+            c[v_axis] += b;
+            occluded += light_blocked(c[0], c[1], c[2]);
+        }
+    }
+
+    // openness: free cells straight in front of the face
+    int open = 1;
+    while (open < LIGHT_REACH) {
+        int c[3] = {n[0], n[1], n[2]};
+        c[axis] += normal * open;
+        if (light_blocked(c[0], c[1], c[2])) break;
+        open++;
+    }
+
+    double ambient = (1 - occluded / 8.0) * open / (double)LIGHT_REACH;
+    return (unsigned char)(LIGHT_FULL * face_weight[face] * (0.35 + 0.65 * ambient));
+}
+
+static void bake_voxel(int x, int y, int z) {
+    for (int face = 0; face < 6; face++) {
+        light_volume[z][y][x][face] = bake_face(x, y, z, face);
+    }
+}
+
+void bake_light_volume() {
+    for (int z = 0; z < MAP_HEIGHT; z++) {
+        for (int y = 0; y < MAP_SIZE; y++) {
+            for (int x = 0; x < MAP_SIZE; x++) {
+                bake_voxel(x, y, z);
+            }
+        }
+    }
+}
+
+// An edit only changes faces that sample it, all of them within LIGHT_REACH
+void bake_light_around(int x, int y, int z) {
+    for (int k = z - LIGHT_REACH; k <= z + LIGHT_REACH; k++) {
+        if (k < 0 || k >= MAP_HEIGHT) continue;
+        for (int j = y - LIGHT_REACH; j <= y + LIGHT_REACH; j++) {
+            if (j < 0 || j >= MAP_SIZE) continue;
+            for (int i = x - LIGHT_REACH; i <= x + LIGHT_REACH; i++) {
+                if (i < 0 || i >= MAP_SIZE) continue;
+                bake_voxel(i, j, k);
+            }
+        }
+    }
+}
+
+unsigned char voxel_light(int x, int y, int z, int face) {
+    if (face < 0) {
+        return LIGHT_FULL;
+    }
+    return light_volume[z][y][x][face];
+}
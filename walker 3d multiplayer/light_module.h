@@ -0,0 +1,19 @@
+#ifndef LIGHT_MODULE_H
+#define LIGHT_MODULE_H
+
+#include "map_module.h"
+
+#define LIGHT_FULL 255
+#define LIGHT_REACH 4 // how far in front of a face the openness is sampled
+
+// Face index of a voxel: axis * 2 + (normal points to +axis)
+#define FACE_INDEX(axis, normal) ((axis) * 2 + ((normal) > 0))
+
+// Baked ambient occlusion and openness per voxel face, LIGHT_FULL for non-solid voxels
+extern unsigned char light_volume[MAP_HEIGHT][MAP_SIZE][MAP_SIZE][6];
+
+void bake_light_volume();
+void bake_light_around(int x, int y, int z);
+unsigned char voxel_light(int x, int y, int z, int face);
+
+#endif // LIGHT_MODULE_H
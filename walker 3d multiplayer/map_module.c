@@ -1,10 +1,21 @@
 #include "map_module.h"
+#include "light_module.h"
 #include <stdio.h>
 #include <string.h>
-#include <time.h>
+#include "alloc_module.h"
 
 // Define the global map
 object_t map[MAP_HEIGHT][MAP_SIZE][MAP_SIZE];
+unsigned int map_version = 0;
+
+// LOD levels 1..MAP_LOD_LEVELS-1 packed one after another
+static lod_cell_t lod_pool[LOD_CELLS(1) + LOD_CELLS(2) + LOD_CELLS(3)];
+static lod_cell_t* lod_levels[MAP_LOD_LEVELS] = {
+    NULL,
+    lod_pool,
+    lod_pool + LOD_CELLS(1),
+    lod_pool + LOD_CELLS(1) + LOD_CELLS(2)
+};
 
 void initialize_map() {
     for (int k = 0; k < MAP_HEIGHT; k++) {
@@ -21,10 +32,11 @@ void initialize_map() {
         }
     }
     // add_random_obstacles();
+    refresh_map_caches();
 }
 
+// Draws from rand(), seed it with srand() first for a reproducible world
 void add_random_obstacles() {
-    srand(time(NULL));
     int wall_count = 100;
     for (int i = 0; i < wall_count; i++) {
         int x = rand() % (MAP_SIZE - 2) + 1;
@@ -38,6 +50,15 @@ void add_random_obstacles() {
     }
 }
 
+// Wall of mirrors across row 20, from x = 10 to the border
+void add_mirror_wall() {
+    for (int z = MAP_HEIGHT * 0.1; z < MAP_HEIGHT * 0.8; z++) {
+        for (int x = 10; x < MAP_SIZE - 1; x++) {
+            map[z][20][x] = create_object(MIRROR_TYPE);
+        }
+    }
+}
+
 object_t create_object(int type) {
     object_t object;
     switch (type) {
@@ -49,12 +70,18 @@ object_t create_object(int type) {
     case MIRROR_TYPE:
         object.symbol = MIRROR_SYMBOL;
         object.type = MIRROR_TYPE;
+        object.color = 0;
         break;
     case VOID_TYPE:
         object.symbol = EMPTY_SYMBOL;
         object.type = VOID_TYPE;
         object.color = 0;
         break;
+    case FOG_TYPE:
+        object.symbol = FOG_SYMBOL;
+        object.type = FOG_TYPE;
+        object.color = 0;
+        break;
     default:
         object.symbol = '?';
         object.type = -1;
@@ -64,6 +91,197 @@ object_t create_object(int type) {
     return object;
 }
 
+lod_cell_t* map_lod_cell(int level, int x, int y, int z) {
+    return &lod_levels[level][(z * LOD_SIZE(level) + y) * LOD_SIZE(level) + x];
+}
+
+static lod_cell_t lod_child(int level, int x, int y, int z) {
+    if (level > 0) {
+        return *map_lod_cell(level, x, y, z);
+    }
+    lod_cell_t cell = {LOD_EMPTY, 0, 0};
+    switch (map[z][y][x].type) {
+    case OBSTACLE_TYPE:
+        cell.occupancy = LOD_SOLID;
+        cell.color = map[z][y][x].color;
+        break;
+    case MIRROR_TYPE:
+        cell.flags = LOD_HAS_MIRROR;
+        break;
+    case PLAYER_TYPE:
+        cell.flags = LOD_HAS_PLAYER;
+        break;
+    case FOG_TYPE:
+        cell.flags = LOD_HAS_FOG;
+        break;
+    default:
+        break;
+    }
+    return cell;
+}
+
+static void reduce_lod_cell(int level, int x, int y, int z) {
+    int child_size = LOD_SIZE(level - 1);
+    int child_height = LOD_HEIGHT(level - 1);
+    int children = 0;
+    int occupied = 0;
+    int solid = 0;
+    int color_votes[8] = {0};
+    unsigned char flags = 0;
+
+    for (int k = 2 * z; k < 2 * z + 2 && k < child_height; k++) {
+        for (int j = 2 * y; j < 2 * y + 2 && j < child_size; j++) {
+            for (int i = 2 * x; i < 2 * x + 2 && i < child_size; i++) {
+                lod_cell_t child = lod_child(level - 1, i, j, k);
+                children++;
+                flags |= child.flags;
+                if (child.occupancy == LOD_EMPTY) continue;
+                occupied++;
+                if (child.occupancy == LOD_SOLID) solid++;
+                color_votes[child.color & 7]++;
+            }
+        }
+    }
+
+    lod_cell_t* cell = map_lod_cell(level, x, y, z);
+    cell->flags = flags;
+    if (occupied == 0) {
+        cell->occupancy = LOD_EMPTY;
+    } else if (solid * 2 >= children) {
+        cell->occupancy = LOD_SOLID;
+    } else {
+        cell->occupancy = LOD_PARTIAL;
+    }
+    cell->color = 0;
+    for (int c = 1; c < 8; c++) {
+        if (color_votes[c] > color_votes[cell->color]) cell->color = c;
+    }
+}
+
+bool apply_voxel_edit(const voxel_edit_t* edit) {
+    if (edit->x < 1 || edit->x >= MAP_SIZE - 1 || edit->y < 1 || edit->y >= MAP_SIZE - 1 ||
+        edit->z < 1 || edit->z >= MAP_HEIGHT - 1) {
+        return false;
+    }
+    if (edit->type != VOID_TYPE && edit->type != OBSTACLE_TYPE && edit->type != MIRROR_TYPE) {
+        return false;
+    }
+    if (edit->type == OBSTACLE_TYPE && (edit->color < 1 || edit->color > 7)) {
+        return false;
+    }
+    object_t object = create_object(edit->type);
+    if (edit->type == OBSTACLE_TYPE) object.color = edit->color;
+    map[edit->z][edit->y][edit->x] = object;
+    refresh_map_caches_at(edit->x, edit->y, edit->z);
+    return true;
+}
+
+void fill_map_with_fog() {
+    object_t fog = create_object(FOG_TYPE);
+    for (int z = 0; z < MAP_HEIGHT; z++) {
+        for (int y = 0; y < MAP_SIZE; y++) {
+            for (int x = 0; x < MAP_SIZE; x++) {
+                map[z][y][x] = fog;
+            }
+        }
+    }
+    refresh_map_caches();
+}
+
+bool map_has_fog() {
+    for (int z = 0; z < MAP_HEIGHT; z++) {
+        for (int y = 0; y < MAP_SIZE; y++) {
+            for (int x = 0; x < MAP_SIZE; x++) {
+                if (map[z][y][x].type == FOG_TYPE) return true;
+            }
+        }
+    }
+    return false;
+}
+
+void refresh_map_caches() {
+    map_version++;
+    build_map_lod();
+    bake_light_volume();
+}
+
+void refresh_map_caches_at(int x, int y, int z) {
+    map_version++;
+    update_map_lod(x, y, z);
+    bake_light_around(x, y, z);
+}
+
+void build_map_lod() {
+    for (int level = 1; level < MAP_LOD_LEVELS; level++) {
+        for (int z = 0; z < LOD_HEIGHT(level); z++) {
+            for (int y = 0; y < LOD_SIZE(level); y++) {
+                for (int x = 0; x < LOD_SIZE(level); x++) {
+                    reduce_lod_cell(level, x, y, z);
+                }
+            }
+        }
+    }
+}
+
+// Re-reduces only the chain of cells above a single edited voxel
+void update_map_lod(int x, int y, int z) {
+    for (int level = 1; level < MAP_LOD_LEVELS; level++) {
+        x >>= 1;
+        y >>= 1;
+        z >>= 1;
+        reduce_lod_cell(level, x, y, z);
+    }
+}
+
+// Players are not part of `map`, so the client marks them every frame
+void map_lod_mark_player(int x, int y, int z) {
+    for (int level = 1; level < MAP_LOD_LEVELS; level++) {
+        map_lod_cell(level, x >> level, y >> level, z >> level)->flags |= LOD_HAS_PLAYER;
+    }
+}
+
+// Temporarily marks a player, `saved` keeps the flags map_lod_pop_player restores
+void map_lod_push_player(int x, int y, int z, unsigned char saved[MAP_LOD_LEVELS]) {
+    for (int level = 1; level < MAP_LOD_LEVELS; level++) {
+        lod_cell_t* cell = map_lod_cell(level, x >> level, y >> level, z >> level);
+        saved[level] = cell->flags;
+        cell->flags |= LOD_HAS_PLAYER;
+    }
+}
+
+void map_lod_pop_player(int x, int y, int z, const unsigned char saved[MAP_LOD_LEVELS]) {
+    for (int level = 1; level < MAP_LOD_LEVELS; level++) {
+        map_lod_cell(level, x >> level, y >> level, z >> level)->flags = saved[level];
+    }
+}
+
+void map_lod_clear_players() {
+    for (size_t i = 0; i < sizeof(lod_pool) / sizeof(lod_pool[0]); i++) {
+        lod_pool[i].flags &= ~LOD_HAS_PLAYER;
+    }
+}
+
+bool wall_collision(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                    double pos_x, double pos_y, double pos_z) {
+    int type = map_to_use[(int)(pos_z)][(int)(pos_y)][(int)(pos_x)].type;
+    return (type == PLAYER_TYPE || type == OBSTACLE_TYPE || type == FOG_TYPE);
+}
+
+// `map` plus the given players as PLAYER_TYPE voxels, which are also marked in the LOD
+void copy_map_with_players(object_t out[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                           position_t* players, int player_count) {
+    memcpy(out, map, sizeof(map));
+    map_lod_clear_players();
+    for (int i = 0; i < player_count; i++) {
+        object_t another_player;
+        another_player.type = PLAYER_TYPE;
+        another_player.symbol = OBSTACLE_SYMBOL;
+        another_player.color = 0;
+        out[(int)players[i].z][(int)players[i].y][(int)players[i].x] = another_player;
+        map_lod_mark_player((int)players[i].x, (int)players[i].y, (int)players[i].z);
+    }
+}
+
 char* serialize_map() {
     size_t buffer_size = MAP_HEIGHT * MAP_SIZE * MAP_SIZE * 10 + 1;
     char* buffer = malloc(buffer_size);
@@ -122,6 +340,7 @@ void deserialize_map(const char* data) {
             }
         }
     }
+    refresh_map_caches();
 }
 
 char* serialize_player(player_t* player) {
@@ -177,7 +396,7 @@ int deserialize_player_positions(char* str, player_position_t* position) {
     if (!str || !position) return -1;
 
     // Parse the string and populate the player_t struct
-    int scanned = sscanf(str, "%f|%f|%f|%d",
+    int scanned = sscanf(str, "%lf|%lf|%lf|%d",
                          &position->x, &position->y, &position->z, &position->index);
 
     // Ensure all fields were successfully read
@@ -13,11 +13,29 @@
 #define OBSTACLE_TYPE 1
 #define MIRROR_TYPE 2
 #define PLAYER_TYPE 3
+#define FOG_TYPE 4 // stands in for voxels the client has not received yet
 
 // Object Symbols
 #define OBSTACLE_SYMBOL '#'
 #define MIRROR_SYMBOL 'M'
 #define EMPTY_SYMBOL '.'
+#define FOG_SYMBOL ' '
+
+// Level-of-detail pyramid: level 0 is `map` itself, every next level is 2x2x2 coarser
+#define MAP_LOD_LEVELS 4
+#define LOD_SIZE(level) ((MAP_SIZE + (1 << (level)) - 1) >> (level))
+#define LOD_HEIGHT(level) ((MAP_HEIGHT + (1 << (level)) - 1) >> (level))
+#define LOD_CELLS(level) (LOD_HEIGHT(level) * LOD_SIZE(level) * LOD_SIZE(level))
+
+// LOD occupancy
+#define LOD_EMPTY 0   // nothing underneath, a ray can skip the whole cell
+#define LOD_PARTIAL 1 // some solid voxels, but not the majority
+#define LOD_SOLID 2   // majority of the voxels underneath are obstacles
+
+// LOD flags: cells that must be resolved at full resolution
+#define LOD_HAS_MIRROR 1
+#define LOD_HAS_PLAYER 2
+#define LOD_HAS_FOG 4
 
 // Structure Definitions
 typedef struct {
@@ -26,6 +44,12 @@ typedef struct {
     char symbol;
 } object_t;
 
+typedef struct {
+    unsigned char occupancy;
+    unsigned char color; // majority color of the solid voxels underneath
+    unsigned char flags;
+} lod_cell_t;
+
 typedef struct {
     double x;
     double y;
@@ -47,14 +71,54 @@ typedef struct {
     int index;
 } player_position_t;
 
+// One voxel set to a new object, the unit of world building
+typedef struct {
+    int x;
+    int y;
+    int z;
+    int type;  // VOID_TYPE, OBSTACLE_TYPE or MIRROR_TYPE
+    int color; // 1..7 for obstacles, ignored otherwise
+} voxel_edit_t;
+
 // Global Map
 extern object_t map[MAP_HEIGHT][MAP_SIZE][MAP_SIZE];
+extern unsigned int map_version; // bumped by refresh_map_caches*, i.e. on every map change
 
 // Function Prototypes
 void initialize_map();
 void add_random_obstacles();
+void add_mirror_wall();
 object_t create_object(int type);
 
+// Writes the edit into `map` and refreshes the caches around it. Edits of the border,
+// outside the map or of another type are refused and return false.
+bool apply_voxel_edit(const voxel_edit_t* edit);
+
+// Whole map as FOG_TYPE, for a client that streams the world in
+void fill_map_with_fog();
+bool map_has_fog();
+
+// derived data (LOD, baked light) and map_version; call after writing into `map`
+void refresh_map_caches();
+void refresh_map_caches_at(int x, int y, int z);
+
+// level-of-detail pyramid over `map`
+void build_map_lod();
+void update_map_lod(int x, int y, int z);
+lod_cell_t* map_lod_cell(int level, int x, int y, int z);
+void map_lod_mark_player(int x, int y, int z);
+void map_lod_clear_players();
+void map_lod_push_player(int x, int y, int z, unsigned char saved[MAP_LOD_LEVELS]);
+void map_lod_pop_player(int x, int y, int z, const unsigned char saved[MAP_LOD_LEVELS]);
+
+// Whether a player cannot step into the voxel, on a map that may have other players added
+bool wall_collision(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                    double pos_x, double pos_y, double pos_z);
+
+// `map` with other players added for rendering
+void copy_map_with_players(object_t out[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                           position_t* players, int player_count);
+
 // map de-/serilaization
 char* serialize_map();
 void deserialize_map(const char* data);
@@ -0,0 +1,81 @@
+#include "movement_module.h"
+
+#define KEY_UP 65
+#define KEY_DOWN 66
+#define KEY_RIGHT 67
+#define KEY_LEFT 68
+
+static bool blocked(double x, double y, double z) {
+    if (x < 0 || y < 0 || z < 0 || x >= MAP_SIZE || y >= MAP_SIZE || z >= MAP_HEIGHT) {
+        return true;
+    }
+    return wall_collision(map, x, y, z);
+}
+
+static void step(position_t* position, double dx, double dy) {
+    if (!blocked(position->x + dx, position->y + dy, position->z)) {
+        position->x += dx;
+        position->y += dy;
+    }
+}
+
+// down to the grid, which keeps the player in the cell it was allowed into
+static double snap(double value) {
+    return floor(value * POSITION_UNITS) / POSITION_UNITS;
+}
+
+bool is_movement_key(int key) {
+    switch (key) {
+    case 'w': case 'a': case 's': case 'd': case 'e': case 'q':
+    case KEY_UP: case KEY_DOWN: case KEY_RIGHT: case KEY_LEFT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void apply_input(player_t* player, const input_command_t* command) {
+    if (!isfinite(command->angleXY) || !isfinite(command->angleZY)) return;
+    player->angleXY = command->angleXY;
+    player->angleZY = command->angleZY;
+    double cos_ = cos(player->angleXY) * cos(player->angleZY);
+    double sin_ = sin(player->angleXY);
+    position_t* position = &player->position;
+    switch (command->key) {
+    case 'd':
+        step(position, -sin_, cos_);
+        break;
+    case 'w':
+        step(position, cos_, sin_);
+        break;
+    case 'a':
+        step(position, sin_, -cos_);
+        break;
+    case 's':
+        step(position, -cos_, -sin_);
+        break;
+    case 'e':
+        if (position->z < MAP_HEIGHT - 1) position->z += 1;
+        break;
+    case 'q':
+        if (position->z > 1) position->z -= 1;
+        break;
+    case KEY_LEFT:
+        player->angleXY -= CAMERA_SPEED;
+        break;
+    case KEY_RIGHT:
+        player->angleXY += CAMERA_SPEED;
+        break;
+    case KEY_UP:
+        player->angleZY -= CAMERA_SPEED;
+        break;
+    case KEY_DOWN:
+        player->angleZY += CAMERA_SPEED;
+        break;
+    default:
+        break;
+    }
+    position->x = snap(position->x);
+    position->y = snap(position->y);
+    position->z = snap(position->z);
+}
@@ -0,0 +1,24 @@
+#ifndef MOVEMENT_MODULE_H
+#define MOVEMENT_MODULE_H
+
+#include <math.h>
+#include <stdbool.h>
+#include "map_module.h"
+#include "protocol_module.h"
+
+// Player movement, run by the client the moment a key is pressed and by the server on the
+// commands the client sends. Both must end on the same position from the same commands:
+// the command carries the view at float precision, as it travels, and positions are kept
+// on the world state grid (1/POSITION_UNITS of a cell), so the server's state replays
+// exactly on the client.
+
+#define CAMERA_SPEED (M_PI / 24)
+
+// wasd, e and q move, the arrow keys turn
+bool is_movement_key(int key);
+
+// Takes the command's view, then moves or turns by its key on `map`. Steps into walls and
+// out of the map are refused.
+void apply_input(player_t* player, const input_command_t* command);
+
+#endif // MOVEMENT_MODULE_H
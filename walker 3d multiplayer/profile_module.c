@@ -0,0 +1,59 @@
+#include "profile_module.h"
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+bool profile_enabled = false;
+
+static _Thread_local profile_event_t ring[PROFILE_RING_SIZE];
+static _Thread_local int ring_next = 0;
+static _Thread_local int ring_count = 0;
+static _Thread_local int thread_id = 0;
+static int thread_count = 0;
+
+void profile_enable(bool enabled) {
+    profile_enabled = enabled;
+}
+
+double profile_clock_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+void profile_record(const char* name, double start_us, double duration_us) {
+    profile_event_t* event = &ring[ring_next];
+    event->name = name;
+    event->start_us = start_us;
+    event->duration_us = duration_us;
+    ring_next = (ring_next + 1) % PROFILE_RING_SIZE;
+    if (ring_count < PROFILE_RING_SIZE) ring_count++;
+}
+
+int profile_export_chrome(const char* file_name, const char* process_name) {
+    FILE* file = fopen(file_name, "w");
+    if (!file) {
+        fprintf(stderr, "Cannot create profile %s\n", file_name);
+        return -1;
+    }
+    if (thread_id == 0) {
+        thread_id = __atomic_add_fetch(&thread_count, 1, __ATOMIC_RELAXED);
+    }
+    int pid = getpid();
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                  "\"args\":{\"name\":\"%s\"}}", pid, thread_id, process_name);
+    int first = (ring_next - ring_count + PROFILE_RING_SIZE) % PROFILE_RING_SIZE;
+    for (int i = 0; i < ring_count; i++) {
+        profile_event_t* event = &ring[(first + i) % PROFILE_RING_SIZE];
+        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                      "\"pid\":%d,\"tid\":%d}",
+                event->name, event->start_us, event->duration_us, pid, thread_id);
+    }
+    fprintf(file, "\n]}\n");
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Failed to write profile %s\n", file_name);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef PROFILE_MODULE_H
+#define PROFILE_MODULE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Stage profiler: scoped timing spans kept in a per-thread ring buffer and exported as
+// Chrome trace JSON (chrome://tracing, ui.perfetto.dev). While disabled a span costs one
+// branch on begin and one on end; building with -DNO_PROFILE compiles them out.
+//
+//     void create_frame() {
+//         PROFILE_SPAN("create_frame"); // ends with the enclosing block
+//         ...
+//     }
+
+#define PROFILE_RING_SIZE 8192 // the oldest spans are overwritten
+
+typedef struct {
+    const char* name; // string literal, NULL when the span is not recorded
+    double start_us;
+} profile_span_t;
+
+typedef struct {
+    const char* name;
+    double start_us;
+    double duration_us;
+} profile_event_t;
+
+extern bool profile_enabled;
+
+void profile_enable(bool enabled);
+double profile_clock_us();
+void profile_record(const char* name, double start_us, double duration_us);
+
+// Spans of the calling thread, oldest first. Returns -1 and prints why on failure.
+int profile_export_chrome(const char* file_name, const char* process_name);
+
+static inline profile_span_t profile_begin(const char* name) {
+    profile_span_t span = {NULL, 0};
+    if (profile_enabled) {
+        span.name = name;
+        span.start_us = profile_clock_us();
+    }
+    return span;
+}
+
+static inline void profile_end(profile_span_t* span) {
+    if (span->name) {
+        profile_record(span->name, span->start_us, profile_clock_us() - span->start_us);
+    }
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef NO_PROFILE
+#define PROFILE_SPAN(name) ((void)0)
+#else
+#define PROFILE_SPAN(name)                                                              \
+    profile_span_t PROFILE_CONCAT(profile_span_, __LINE__)                               \
+        __attribute__((cleanup(profile_end))) = profile_begin(name)
+#endif
+
+#endif // PROFILE_MODULE_H
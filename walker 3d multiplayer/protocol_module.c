@@ -0,0 +1,343 @@
+#include "protocol_module.h"
+#include <string.h>
+
+static unsigned char* put_f32(unsigned char* out, double value) {
+    float f = (float)value;
+    unsigned int bits;
+    memcpy(&bits, &f, 4);
+    out[0] = bits & 0xff;
+    out[1] = (bits >> 8) & 0xff;
+    out[2] = (bits >> 16) & 0xff;
+    out[3] = (bits >> 24) & 0xff;
+    return out + 4;
+}
+
+static const unsigned char* get_f32(const unsigned char* in, double* value) {
+    unsigned int bits = in[0] | (in[1] << 8) | (in[2] << 16) | ((unsigned int)in[3] << 24);
+    float f;
+    memcpy(&f, &bits, 4);
+    *value = f;
+    return in + 4;
+}
+
+static unsigned char* put_u16(unsigned char* out, int value) {
+    out[0] = value & 0xff;
+    out[1] = (value >> 8) & 0xff;
+    return out + 2;
+}
+
+static int get_u16(const unsigned char* in) {
+    return in[0] | (in[1] << 8);
+}
+
+static unsigned char* put_u32(unsigned char* out, unsigned int value) {
+    out[0] = value & 0xff;
+    out[1] = (value >> 8) & 0xff;
+    out[2] = (value >> 16) & 0xff;
+    out[3] = (value >> 24) & 0xff;
+    return out + 4;
+}
+
+static unsigned int get_u32(const unsigned char* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((unsigned int)in[3] << 24);
+}
+
+static unsigned char* put_edits(unsigned char* out, const voxel_edit_t* edits, int count) {
+    out[0] = count & 0xff;
+    out[1] = (count >> 8) & 0xff;
+    unsigned char* p = out + 2;
+    for (int i = 0; i < count; i++) {
+        *p++ = edits[i].x;
+        *p++ = edits[i].y;
+        *p++ = edits[i].z;
+        *p++ = edits[i].type;
+        *p++ = edits[i].color;
+    }
+    return p;
+}
+
+// nearest step, clamped to what 16 bits hold
+static int quantize_coordinate(double value) {
+    if (!(value > 0)) return 0;
+    if (value >= (double)POSITION_MAX / POSITION_UNITS) return POSITION_MAX;
+    return (int)(value * POSITION_UNITS + 0.5);
+}
+
+// `data` points at the count, `size` is what is left of the message
+static int get_edits(const unsigned char* data, size_t size, voxel_edit_t* edits, int capacity) {
+    int count = data[0] | (data[1] << 8);
+    if (count > capacity || size < 2 + VOXEL_EDIT_BYTES * (size_t)count) return -1;
+    const unsigned char* p = data + 2;
+    for (int i = 0; i < count; i++) {
+        edits[i].x = p[0];
+        edits[i].y = p[1];
+        edits[i].z = p[2];
+        edits[i].type = (signed char)p[3];
+        edits[i].color = p[4];
+        p += VOXEL_EDIT_BYTES;
+    }
+    return count;
+}
+
+int message_type(const unsigned char* data, size_t size) {
+    if (size < 1 || (data[0] >> 4) != PROTOCOL_VERSION) return -1;
+    return data[0] & 0x0f;
+}
+
+static int is_message(const unsigned char* data, size_t size, int type, size_t min_size) {
+    return size >= min_size && data[0] == MESSAGE_HEADER(type);
+}
+
+bool sequence_newer(int sequence, int than) {
+    return (short)(unsigned short)(sequence - than) > 0;
+}
+
+int encode_player(const player_t* player, unsigned char* out, size_t size) {
+    if (size < PLAYER_MESSAGE_SIZE) return -1;
+    out[0] = MESSAGE_HEADER(MESSAGE_PLAYER);
+    unsigned char* p = out + 1;
+    p = put_f32(p, player->position.x);
+    p = put_f32(p, player->position.y);
+    p = put_f32(p, player->position.z);
+    p = put_f32(p, player->angleXY);
+    p = put_f32(p, player->angleZY);
+    *p = player->color;
+    return PLAYER_MESSAGE_SIZE;
+}
+
+int decode_player(const unsigned char* data, size_t size, player_t* player) {
+    if (!is_message(data, size, MESSAGE_PLAYER, PLAYER_MESSAGE_SIZE)) return -1;
+    const unsigned char* p = data + 1;
+    p = get_f32(p, &player->position.x);
+    p = get_f32(p, &player->position.y);
+    p = get_f32(p, &player->position.z);
+    p = get_f32(p, &player->angleXY);
+    p = get_f32(p, &player->angleZY);
+    player->color = *p;
+    return 0;
+}
+
+int encode_positions(const position_t* positions, int count, unsigned char* out, size_t size) {
+    if (count < 0 || count > PROTOCOL_MAX_PLAYERS || size < POSITIONS_MESSAGE_SIZE(count)) {
+        return -1;
+    }
+    out[0] = MESSAGE_HEADER(MESSAGE_POSITIONS);
+    out[1] = count;
+    unsigned char* p = out + 2;
+    for (int i = 0; i < count; i++) {
+        p = put_f32(p, positions[i].x);
+        p = put_f32(p, positions[i].y);
+        p = put_f32(p, positions[i].z);
+    }
+    return (int)POSITIONS_MESSAGE_SIZE(count);
+}
+
+int decode_positions(const unsigned char* data, size_t size, position_t* positions, int capacity) {
+    if (!is_message(data, size, MESSAGE_POSITIONS, 2)) return -1;
+    int count = data[1];
+    if (size < POSITIONS_MESSAGE_SIZE(count)) return -1;
+    const unsigned char* p = data + 2;
+    for (int i = 0; i < count && i < capacity; i++) {
+        p = get_f32(p, &positions[i].x);
+        p = get_f32(p, &positions[i].y);
+        p = get_f32(p, &positions[i].z);
+    }
+    return count;
+}
+
+int encode_voxel_edits(const voxel_edit_t* edits, int count, unsigned char* out, size_t size) {
+    if (count < 0 || count > MAX_VOXEL_EDITS || size < VOXEL_EDITS_MESSAGE_SIZE(count)) {
+        return -1;
+    }
+    out[0] = MESSAGE_HEADER(MESSAGE_VOXEL_EDITS);
+    put_edits(out + 1, edits, count);
+    return (int)VOXEL_EDITS_MESSAGE_SIZE(count);
+}
+
+int decode_voxel_edits(const unsigned char* data, size_t size, voxel_edit_t* edits, int capacity) {
+    if (!is_message(data, size, MESSAGE_VOXEL_EDITS, VOXEL_EDITS_MESSAGE_SIZE(0))) return -1;
+    return get_edits(data + 1, size - 1, edits, capacity);
+}
+
+int encode_map_delta(unsigned int base, unsigned int version, const voxel_edit_t* edits,
+                     int count, unsigned char* out, size_t size) {
+    if (count < 0 || count > MAX_VOXEL_EDITS || size < MAP_DELTA_MESSAGE_SIZE(count)) return -1;
+    out[0] = MESSAGE_HEADER(MESSAGE_MAP_DELTA);
+    unsigned char* p = put_u32(out + 1, base);
+    p = put_u32(p, version);
+    put_edits(p, edits, count);
+    return (int)MAP_DELTA_MESSAGE_SIZE(count);
+}
+
+int decode_map_delta(const unsigned char* data, size_t size, unsigned int* base,
+                     unsigned int* version, voxel_edit_t* edits, int capacity) {
+    if (!is_message(data, size, MESSAGE_MAP_DELTA, MAP_DELTA_MESSAGE_SIZE(0))) return -1;
+    *base = get_u32(data + 1);
+    *version = get_u32(data + 5);
+    return get_edits(data + 9, size - 9, edits, capacity);
+}
+
+void quantize_position(const position_t* position, player_state_t* state) {
+    state->x = quantize_coordinate(position->x);
+    state->y = quantize_coordinate(position->y);
+    state->z = quantize_coordinate(position->z);
+}
+
+position_t player_state_position(const player_state_t* state) {
+    position_t position;
+    position.x = (double)state->x / POSITION_UNITS;
+    position.y = (double)state->y / POSITION_UNITS;
+    position.z = (double)state->z / POSITION_UNITS;
+    return position;
+}
+
+int encode_world_state(const world_state_t* state, const world_state_t* baseline,
+                       unsigned char* out, size_t size) {
+    static const world_state_t nobody;
+    if (size < WORLD_STATE_MAX_SIZE || state->own_index < 0 ||
+        state->own_index >= PROTOCOL_MAX_PLAYERS || state->tick_rate < 1 ||
+        state->tick_rate > 255) {
+        return -1;
+    }
+    const world_state_t* base = baseline ? baseline : &nobody;
+    int slots = 0;
+    for (int i = 0; i < PROTOCOL_MAX_PLAYERS; i++) {
+        if (state->players[i].present || base->players[i].present) slots = i + 1;
+    }
+
+    out[0] = MESSAGE_HEADER(MESSAGE_WORLD_STATE);
+    put_u16(out + 1, state->tick);
+    put_u16(out + 3, baseline ? baseline->tick : 0);
+    out[5] = baseline ? WORLD_STATE_DELTA : 0;
+    out[6] = state->own_index;
+    put_u16(out + 7, state->input_ack);
+    out[9] = state->tick_rate;
+    out[10] = slots;
+    unsigned char* changed = out + WORLD_STATE_HEADER_SIZE;
+    memset(changed, 0, (slots + 7) / 8);
+    unsigned char* p = changed + (slots + 7) / 8;
+    for (int i = 0; i < slots; i++) {
+        const player_state_t* now = &state->players[i];
+        const player_state_t* was = &base->players[i];
+        int mask = 0;
+        if (now->present) {
+            mask = PLAYER_STATE_PRESENT;
+            if (!was->present || now->x != was->x) mask |= PLAYER_STATE_X;
+            if (!was->present || now->y != was->y) mask |= PLAYER_STATE_Y;
+            if (!was->present || now->z != was->z) mask |= PLAYER_STATE_Z;
+            if (mask == PLAYER_STATE_PRESENT) continue;
+        } else if (!was->present) {
+            continue;
+        }
+        changed[i / 8] |= 1 << (i % 8);
+        *p++ = mask;
+        if (mask & PLAYER_STATE_X) p = put_u16(p, now->x);
+        if (mask & PLAYER_STATE_Y) p = put_u16(p, now->y);
+        if (mask & PLAYER_STATE_Z) p = put_u16(p, now->z);
+    }
+    return (int)(p - out);
+}
+
+int world_state_baseline(const unsigned char* data, size_t size) {
+    if (!is_message(data, size, MESSAGE_WORLD_STATE, WORLD_STATE_HEADER_SIZE) ||
+        !(data[5] & WORLD_STATE_DELTA)) {
+        return -1;
+    }
+    return get_u16(data + 3);
+}
+
+int decode_world_state(const unsigned char* data, size_t size, const world_state_t* baseline,
+                       world_state_t* state) {
+    if (!is_message(data, size, MESSAGE_WORLD_STATE, WORLD_STATE_HEADER_SIZE)) return -1;
+    bool delta = data[5] & WORLD_STATE_DELTA;
+    int slots = data[10];
+    size_t changed_bytes = (slots + 7) / 8;
+    if (data[6] >= PROTOCOL_MAX_PLAYERS || data[9] == 0 || slots > PROTOCOL_MAX_PLAYERS ||
+        size < WORLD_STATE_HEADER_SIZE + changed_bytes ||
+        (delta && (!baseline || baseline->tick != get_u16(data + 3)))) {
+        return -1;
+    }
+    if (!delta) {
+        memset(state->players, 0, sizeof(state->players));
+    } else if (state != baseline) {
+        memcpy(state->players, baseline->players, sizeof(state->players));
+    }
+    state->tick = get_u16(data + 1);
+    state->own_index = data[6];
+    state->input_ack = get_u16(data + 7);
+    state->tick_rate = data[9];
+
+    const unsigned char* changed = data + WORLD_STATE_HEADER_SIZE;
+    const unsigned char* p = changed + changed_bytes;
+    const unsigned char* end = data + size;
+    for (int i = 0; i < slots; i++) {
+        if (!(changed[i / 8] & (1 << (i % 8)))) continue;
+        if (p >= end) return -1;
+        int mask = *p++;
+        int coordinates = !!(mask & PLAYER_STATE_X) + !!(mask & PLAYER_STATE_Y) +
+                          !!(mask & PLAYER_STATE_Z);
+        if (end - p < 2 * coordinates) return -1;
+        player_state_t* player = &state->players[i];
+        player->present = mask & PLAYER_STATE_PRESENT;
+        if (mask & PLAYER_STATE_X) {
+            player->x = get_u16(p);
+            p += 2;
+        }
+        if (mask & PLAYER_STATE_Y) {
+            player->y = get_u16(p);
+            p += 2;
+        }
+        if (mask & PLAYER_STATE_Z) {
+            player->z = get_u16(p);
+            p += 2;
+        }
+    }
+    return 0;
+}
+
+int encode_state_ack(int tick, unsigned char* out, size_t size) {
+    if (size < STATE_ACK_MESSAGE_SIZE) return -1;
+    out[0] = MESSAGE_HEADER(MESSAGE_STATE_ACK);
+    put_u16(out + 1, tick);
+    return STATE_ACK_MESSAGE_SIZE;
+}
+
+int decode_state_ack(const unsigned char* data, size_t size, int* tick) {
+    if (!is_message(data, size, MESSAGE_STATE_ACK, STATE_ACK_MESSAGE_SIZE)) return -1;
+    *tick = get_u16(data + 1);
+    return 0;
+}
+
+int encode_input_commands(const input_command_t* commands, int count, unsigned char* out,
+                          size_t size) {
+    if (count < 0 || count > INPUT_COMMANDS_MAX || size < INPUT_COMMANDS_MESSAGE_SIZE(count)) {
+        return -1;
+    }
+    out[0] = MESSAGE_HEADER(MESSAGE_INPUT_COMMANDS);
+    out[1] = count;
+    unsigned char* p = out + 2;
+    for (int i = 0; i < count; i++) {
+        p = put_u16(p, commands[i].sequence);
+        *p++ = commands[i].key;
+        p = put_f32(p, commands[i].angleXY);
+        p = put_f32(p, commands[i].angleZY);
+    }
+    return (int)INPUT_COMMANDS_MESSAGE_SIZE(count);
+}
+
+int decode_input_commands(const unsigned char* data, size_t size, input_command_t* commands,
+                          int capacity) {
+    if (!is_message(data, size, MESSAGE_INPUT_COMMANDS, INPUT_COMMANDS_MESSAGE_SIZE(0))) {
+        return -1;
+    }
+    int count = data[1];
+    if (count > capacity || size < INPUT_COMMANDS_MESSAGE_SIZE(count)) return -1;
+    const unsigned char* p = data + 2;
+    for (int i = 0; i < count; i++) {
+        commands[i].sequence = get_u16(p);
+        commands[i].key = p[2];
+        p = get_f32(p + 3, &commands[i].angleXY);
+        p = get_f32(p, &commands[i].angleZY);
+    }
+    return count;
+}
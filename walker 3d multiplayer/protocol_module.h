@@ -0,0 +1,147 @@
+#ifndef PROTOCOL_MODULE_H
+#define PROTOCOL_MODULE_H
+
+#include <stddef.h>
+#include "map_module.h"
+
+// Binary wire messages. Every message starts with one header byte, the protocol version
+// in the high nibble and the message type in the low one, followed by a fixed layout of
+// little-endian fields. Coordinates and angles travel as IEEE float32.
+// Encoders write into the caller's buffer and return the bytes written, or -1 when it is
+// too small. Decoders return 0, or -1 for a short message, another type or version.
+
+#define PROTOCOL_VERSION 2
+#define PROTOCOL_MAX_PLAYERS 64 // player indices fit in one byte
+
+#define MESSAGE_PLAYER 1          // x, y, z, angleXY, angleZY (f32), color (u8)
+#define MESSAGE_POSITIONS 3       // count (u8), then count times x, y, z (f32)
+#define MESSAGE_MAP_SNAPSHOT 4    // see snapshot_module.h
+#define MESSAGE_VOXEL_EDITS 5     // count (u16), then count edits
+#define MESSAGE_MAP_DELTA 6       // base and new world version (u32), count (u16), edits
+#define MESSAGE_RESYNC_REQUEST 7  // see snapshot_module.h
+#define MESSAGE_WORLD_STATE 8     // see world_state_t
+#define MESSAGE_STATE_ACK 9       // tick (u16) of the newest world state received
+#define MESSAGE_INPUT_COMMANDS 10 // count (u8), then count commands
+#define MESSAGE_CHUNK_HASHES 11   // see snapshot_module.h
+#define MESSAGE_CHUNK_REQUEST 12  // see snapshot_module.h
+
+// ENet connect data of a client that holds a cached world: a resync request follows and
+// the server sends only the chunks it lacks
+#define JOIN_WITH_HASHES 1
+
+#define MESSAGE_HEADER(type) ((PROTOCOL_VERSION << 4) | (type))
+
+#define PLAYER_MESSAGE_SIZE 22
+#define POSITIONS_MESSAGE_SIZE(count) (2 + 12 * (size_t)(count))
+
+// an edit is x, y, z (u8), type (i8), color (u8)
+#define VOXEL_EDIT_BYTES 5
+#define MAX_VOXEL_EDITS 256 // per message
+#define VOXEL_EDITS_MESSAGE_SIZE(count) (3 + VOXEL_EDIT_BYTES * (size_t)(count))
+#define MAP_DELTA_MESSAGE_SIZE(count) (11 + VOXEL_EDIT_BYTES * (size_t)(count))
+#define STATE_ACK_MESSAGE_SIZE 3
+
+// a command is sequence (u16), key (u8), angleXY, angleZY (f32)
+#define INPUT_COMMAND_BYTES 11
+#define INPUT_COMMANDS_MAX 32 // per message, also the commands a client keeps unacknowledged
+#define INPUT_COMMANDS_MESSAGE_SIZE(count) (2 + INPUT_COMMAND_BYTES * (size_t)(count))
+
+// x, y, z sit at the same place in player and player-position messages
+#define MESSAGE_POSITION_OFFSET 1
+#define MESSAGE_POSITION_BYTES 12
+
+// World state coordinates are quantized to 1/POSITION_UNITS of a cell in 16 bits,
+// which covers maps of up to 256 cells
+#define POSITION_UNITS 256
+#define POSITION_MAX 65535
+
+typedef struct {
+    bool present;
+    int x, y, z; // quantized
+} player_state_t;
+
+// Every joined player as of one server tick, sent to each client once per tick. A state is
+// encoded against a baseline, an earlier state the client acknowledged, and carries only
+// the players that changed since:
+//   u16 tick, u16 baseline tick, u8 flags (WORLD_STATE_DELTA when there is a baseline),
+//   u8 own index, u16 input ack, u8 tick rate, u8 slot count N, N bits marking the slots
+//   that changed, then per changed slot a u8 mask of PLAYER_STATE_* and the u16
+//   coordinates it names.
+// Without a baseline every present player has changed from nothing. An unchanged player
+// costs one bit, a player that left a mask byte.
+typedef struct {
+    int tick;
+    int own_index; // the recipient's own slot
+    int input_ack; // sequence of the recipient's newest command the server ran
+    int tick_rate; // ticks per second, 1..255
+    player_state_t players[PROTOCOL_MAX_PLAYERS]; // by player index
+} world_state_t;
+
+#define WORLD_STATE_DELTA 1
+#define PLAYER_STATE_PRESENT 1
+#define PLAYER_STATE_X 2
+#define PLAYER_STATE_Y 4
+#define PLAYER_STATE_Z 8
+
+#define WORLD_STATE_HEADER_SIZE 11
+#define WORLD_STATE_MAX_SIZE \
+    (WORLD_STATE_HEADER_SIZE + PROTOCOL_MAX_PLAYERS / 8 + PROTOCOL_MAX_PLAYERS * 7)
+// Ticks a state stays usable as a baseline; both ends keep this many states
+#define WORLD_STATE_HISTORY 32
+
+// MESSAGE_* of a message of the current version, -1 otherwise
+int message_type(const unsigned char* data, size_t size);
+
+// Whether 16-bit `sequence` comes after `than`, across wrap-around
+bool sequence_newer(int sequence, int than);
+
+int encode_player(const player_t* player, unsigned char* out, size_t size);
+int decode_player(const unsigned char* data, size_t size, player_t* player);
+
+// Decodes at most `capacity` positions and returns how many there were, -1 on error
+int encode_positions(const position_t* positions, int count, unsigned char* out, size_t size);
+int decode_positions(const unsigned char* data, size_t size, position_t* positions, int capacity);
+
+// Edits a client asks for. Decoders return the edit count, -1 on error or more than
+// `capacity` edits.
+int encode_voxel_edits(const voxel_edit_t* edits, int count, unsigned char* out, size_t size);
+int decode_voxel_edits(const unsigned char* data, size_t size, voxel_edit_t* edits, int capacity);
+
+// Edits the server applied, taking the world from version `base` to `version`
+int encode_map_delta(unsigned int base, unsigned int version, const voxel_edit_t* edits,
+                     int count, unsigned char* out, size_t size);
+int decode_map_delta(const unsigned char* data, size_t size, unsigned int* base,
+                     unsigned int* version, voxel_edit_t* edits, int capacity);
+
+void quantize_position(const position_t* position, player_state_t* state);
+position_t player_state_position(const player_state_t* state);
+
+// `baseline` is NULL for a complete state. `size` must be at least WORLD_STATE_MAX_SIZE.
+int encode_world_state(const world_state_t* state, const world_state_t* baseline,
+                       unsigned char* out, size_t size);
+// Tick of the baseline a world state needs, -1 when it needs none or is malformed
+int world_state_baseline(const unsigned char* data, size_t size);
+// -1 also when the state needs a baseline and `baseline` is NULL or of another tick.
+// `state` may be `baseline`.
+int decode_world_state(const unsigned char* data, size_t size, const world_state_t* baseline,
+                       world_state_t* state);
+
+int encode_state_ack(int tick, unsigned char* out, size_t size);
+int decode_state_ack(const unsigned char* data, size_t size, int* tick);
+
+// One key a player pressed, with the view it was pressed in; see movement_module.h
+typedef struct {
+    int sequence; // u16, counts the commands of a client
+    int key;
+    double angleXY;
+    double angleZY;
+} input_command_t;
+
+// Commands oldest first. The decoder returns their count, -1 on error or more than
+// `capacity` commands.
+int encode_input_commands(const input_command_t* commands, int count, unsigned char* out,
+                          size_t size);
+int decode_input_commands(const unsigned char* data, size_t size, input_command_t* commands,
+                          int capacity);
+
+#endif // PROTOCOL_MODULE_H
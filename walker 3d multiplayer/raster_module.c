@@ -0,0 +1,378 @@
+#include "raster_module.h"
+#include "light_module.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "alloc_module.h"
+
+// Mesh of `map` itself, players are added as unit cubes every frame
+static face_list_t world_mesh;
+static bool world_mesh_built = false;
+static unsigned int world_mesh_version;
+
+static void axis_dims(int axis, int* w_size, int* u_size, int* v_size) {
+    *w_size = (axis == 2) ? MAP_HEIGHT : MAP_SIZE;
+    *u_size = MAP_SIZE;
+    *v_size = (axis == 2) ? MAP_SIZE : MAP_HEIGHT;
+}
+
+// (w, u, v) -> (x, y, z) for faces perpendicular to `axis`
+static void axis_to_xyz(int axis, int w, int u, int v, int xyz[3]) {
+    switch (axis) {
+    case 0:
+        xyz[0] = w; xyz[1] = u; xyz[2] = v;
+        break;
+    case 1:
+        xyz[0] = u; xyz[1] = w; xyz[2] = v;
+        break;
+    default:
+        xyz[0] = u; xyz[1] = v; xyz[2] = w;
+        break;
+    }
+}
+
+static int voxel_type(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                      int axis, int w, int u, int v) {
+    int xyz[3];
+    axis_to_xyz(axis, w, u, v, xyz);
+    if (xyz[0] < 0 || xyz[0] >= MAP_SIZE || xyz[1] < 0 || xyz[1] >= MAP_SIZE ||
+        xyz[2] < 0 || xyz[2] >= MAP_HEIGHT) {
+        return OBSTACLE_TYPE; // outside faces are never seen
+    }
+    return map_to_use[xyz[2]][xyz[1]][xyz[0]].type;
+}
+
+// Type of the face a voxel shows towards its neighbour, VOID_TYPE when hidden
+static int exposed_face(int type, int neighbour) {
+    if (type == OBSTACLE_TYPE && (neighbour == VOID_TYPE || neighbour == MIRROR_TYPE)) {
+        return OBSTACLE_TYPE;
+    }
+    if (type == MIRROR_TYPE && neighbour == VOID_TYPE) {
+        return MIRROR_TYPE;
+    }
+    if (type == FOG_TYPE && neighbour == VOID_TYPE) {
+        return FOG_TYPE;
+    }
+    return VOID_TYPE;
+}
+
+static void add_face(face_list_t* mesh, face_t face) {
+    if (mesh->count == mesh->capacity) {
+        int capacity = mesh->capacity ? mesh->capacity * 2 : 256;
+        face_t* faces = realloc(mesh->faces, sizeof(face_t) * capacity);
+        if (!faces) {
+            fprintf(stderr, "Failed to allocate memory for the face mesh.\n");
+            return;
+        }
+        mesh->faces = faces;
+        mesh->capacity = capacity;
+    }
+    mesh->faces[mesh->count++] = face;
+}
+
+// Faces are merged by type only, colors are looked up per pixel at the hit voxel
+void mesh_exposed_faces(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE], face_list_t* mesh) {
+    int mask[MAP_SIZE][MAP_SIZE];
+    mesh->count = 0;
+
+    for (int axis = 0; axis < 3; axis++) {
+        int w_size, u_size, v_size;
+        axis_dims(axis, &w_size, &u_size, &v_size);
+        for (int normal = -1; normal <= 1; normal += 2) {
+            for (int w = 0; w < w_size; w++) {
+                for (int v = 0; v < v_size; v++) {
+                    for (int u = 0; u < u_size; u++) {
+                        mask[v][u] = exposed_face(voxel_type(map_to_use, axis, w, u, v),
+                                                  voxel_type(map_to_use, axis, w + normal, u, v));
+                    }
+                }
+
+                for (int v = 0; v < v_size; v++) {
+                    for (int u = 0; u < u_size; ) {
+                        int type = mask[v][u];
+                        if (type == VOID_TYPE) {
+                            u++;
+                            continue;
+                        }
+                        int width = 1;
+                        while (u + width < u_size && mask[v][u + width] == type) width++;
+                        int height = 1;
+                        bool grow = true;
+                        while (grow && v + height < v_size) {
+                            for (int k = 0; k < width; k++) {
+                                if (mask[v + height][u + k] != type) {
+                                    grow = false;
+                                    break;
+                                }
+                            }
+                            if (grow) height++;
+                        }
+                        for (int dv = 0; dv < height; dv++) {
+                            for (int du = 0; du < width; du++) {
+                                mask[v + dv][u + du] = VOID_TYPE;
+                            }
+                        }
+
+                        face_t face;
+                        face.axis = axis;
+                        face.normal = normal;
+                        face.type = type;
+                        face.plane = (normal > 0) ? w + 1 : w;
+                        face.u0 = u;
+                        face.u1 = u + width;
+                        face.v0 = v;
+                        face.v1 = v + height;
+                        add_face(mesh, face);
+                        u += width;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void free_face_list(face_list_t* mesh) {
+    free(mesh->faces);
+    mesh->faces = NULL;
+    mesh->count = 0;
+    mesh->capacity = 0;
+}
+
+static void face_box(const face_t* face, double lo[3], double hi[3]) {
+    int from[3], to[3];
+    axis_to_xyz(face->axis, face->plane, face->u0, face->v0, from);
+    axis_to_xyz(face->axis, face->plane, face->u1, face->v1, to);
+    for (int k = 0; k < 3; k++) {
+        lo[k] = from[k];
+        hi[k] = to[k];
+    }
+}
+
+static double wrap_angle(double angle) {
+    angle = fmod(angle + M_PI, 2 * M_PI);
+    if (angle < 0) angle += 2 * M_PI;
+    return angle - M_PI;
+}
+
+static bool pixel_range(double angle_min, double angle_max, double fov, int count,
+                        int* first, int* last) {
+    // pixel k looks at fov * ((k + 1) / count - 1/2) from the view center
+    *first = (int)floor((angle_min + fov / 2) / fov * count - 1);
+    *last = (int)ceil((angle_max + fov / 2) / fov * count - 1);
+    if (*first < 0) *first = 0;
+    if (*last > count - 1) *last = count - 1;
+    return *first <= *last;
+}
+
+// Culls the face against the view and returns the pixel rectangle it can cover
+static bool face_pixel_bounds(const face_t* face, player_t* viewer, const double eye[3],
+                              int I, int J, int* i0, int* i1, int* j0, int* j1) {
+    double eye_on_axis = eye[face->axis];
+    if ((face->normal > 0 && eye_on_axis <= face->plane) ||
+        (face->normal < 0 && eye_on_axis >= face->plane)) {
+        return false; // back face
+    }
+
+    double lo[3], hi[3];
+    face_box(face, lo, hi);
+    double nearest_sq = 0;
+    for (int k = 0; k < 3; k++) {
+        double d = fmax(fmax(lo[k] - eye[k], 0), eye[k] - hi[k]);
+        nearest_sq += d * d;
+    }
+    if (nearest_sq > max_ray_lenght * max_ray_lenght) {
+        return false;
+    }
+
+    *i0 = 0;
+    *i1 = I - 1;
+    *j0 = 0;
+    *j1 = J - 1;
+    // close to straight up or down the angular mapping folds, scan the whole screen
+    if (fabs(viewer->angleZY) + HEIGHT_ANGLE / 2 >= M_PI / 2) {
+        return true;
+    }
+
+    double dx_near = fmax(fmax(lo[0] - eye[0], 0), eye[0] - hi[0]);
+    double dy_near = fmax(fmax(lo[1] - eye[1], 0), eye[1] - hi[1]);
+    double h_min = sqrt(dx_near * dx_near + dy_near * dy_near);
+    double h_max = 0;
+    double azimuth_min = INFINITY, azimuth_max = -INFINITY;
+    for (int c = 0; c < 4; c++) {
+        double cx = ((c & 1) ? hi[0] : lo[0]) - eye[0];
+        double cy = ((c & 2) ? hi[1] : lo[1]) - eye[1];
+        h_max = fmax(h_max, sqrt(cx * cx + cy * cy));
+        double azimuth = wrap_angle(atan2(cy, cx) - viewer->angleXY);
+        azimuth_min = fmin(azimuth_min, azimuth);
+        azimuth_max = fmax(azimuth_max, azimuth);
+    }
+
+    double dz_min = lo[2] - eye[2];
+    double dz_max = hi[2] - eye[2];
+    double elevation_min = atan2(dz_min, dz_min >= 0 ? h_max : h_min) - viewer->angleZY;
+    double elevation_max = atan2(dz_max, dz_max >= 0 ? h_min : h_max) - viewer->angleZY;
+    if (!pixel_range(elevation_min, elevation_max, HEIGHT_ANGLE, I, i0, i1)) {
+        return false;
+    }
+
+    // a footprint around the eye or across the back seam spans every direction
+    if (h_min > 0 && azimuth_max - azimuth_min < M_PI) {
+        if (!pixel_range(azimuth_min, azimuth_max, VIEW_ANGLE, J, j0, j1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void draw_face(const face_t* face, const double eye[3], int I, int J,
+                      int i0, int i1, int j0, int j1,
+                      const double* row_cos, const double* row_sin,
+                      const double* column_cos, const double* column_sin,
+                      float* depth, const face_t** hit) {
+    int u_axis = (face->axis == 0) ? 1 : 0;
+    int v_axis = (face->axis == 2) ? 1 : 2;
+    for (int i = i0; i <= i1; i++) {
+        for (int j = j0; j <= j1; j++) {
+            double dir[3] = {
+                row_cos[i] * column_cos[j],
+                row_cos[i] * column_sin[j],
+                row_sin[i]
+            };
+            if (dir[face->axis] == 0) continue;
+            double t = (face->plane - eye[face->axis]) / dir[face->axis];
+            int p = i * J + j;
+            if (t <= 0 || t >= depth[p]) continue;
+            double u = eye[u_axis] + t * dir[u_axis];
+            double v = eye[v_axis] + t * dir[v_axis];
+            if (u < face->u0 || u >= face->u1 || v < face->v0 || v >= face->v1) continue;
+            depth[p] = t;
+            hit[p] = face;
+        }
+    }
+}
+
+static void player_faces(position_t* player, face_t faces[6]) {
+    int cell[3] = {(int)player->x, (int)player->y, (int)player->z};
+    for (int axis = 0; axis < 3; axis++) {
+        int u_axis = (axis == 0) ? 1 : 0;
+        int v_axis = (axis == 2) ? 1 : 2;
+        for (int side = 0; side < 2; side++) {
+            face_t* face = &faces[axis * 2 + side];
+            face->axis = axis;
+            face->normal = side ? 1 : -1;
+            face->type = PLAYER_TYPE;
+            face->plane = cell[axis] + side;
+            face->u0 = cell[u_axis];
+            face->u1 = cell[u_axis] + 1;
+            face->v0 = cell[v_axis];
+            face->v1 = cell[v_axis] + 1;
+        }
+    }
+}
+
+rays_list_t* rasterize_frame(player_t* viewer, int I, int J,
+                             object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                             position_t* players, int player_count) {
+    if (!world_mesh_built || world_mesh_version != map_version) {
+        mesh_exposed_faces(map, &world_mesh);
+        world_mesh_built = true;
+        world_mesh_version = map_version;
+    }
+
+    rays_list_t* list = alloc_rays(I, J);
+    float* depth = malloc(sizeof(float) * (I * J));
+    const face_t** hit = malloc(sizeof(face_t*) * (I * J));
+    double* angles = malloc(sizeof(double) * 2 * (I + J));
+    face_t* extra = malloc(sizeof(face_t) * 6 * (player_count > 0 ? player_count : 1));
+    if (!list || !depth || !hit || !angles || !extra) {
+        free_rays(list);
+        free(depth);
+        free(hit);
+        free(angles);
+        free(extra);
+        return NULL;
+    }
+
+    double* row_cos = angles;
+    double* row_sin = row_cos + I;
+    double* column_cos = row_sin + I;
+    double* column_sin = column_cos + J;
+    for (int i = 0; i < I; i++) {
+        double angle = row_angle(viewer, i, I);
+        row_cos[i] = cos(angle);
+        row_sin[i] = sin(angle);
+    }
+    for (int j = 0; j < J; j++) {
+        double angle = column_angle(viewer, j, J);
+        column_cos[j] = cos(angle);
+        column_sin[j] = sin(angle);
+    }
+    for (int p = 0; p < I * J; p++) {
+        depth[p] = INFINITY;
+        hit[p] = NULL;
+    }
+
+    double eye[3] = {
+        viewer->position.x + 0.5,
+        viewer->position.y + 0.5,
+        viewer->position.z + 0.5
+    };
+
+    for (int k = 0; k < player_count; k++) {
+        player_faces(&players[k], &extra[k * 6]);
+    }
+    int face_count = world_mesh.count + player_count * 6;
+    for (int f = 0; f < face_count; f++) {
+        const face_t* face = (f < world_mesh.count) ? &world_mesh.faces[f]
+                                                    : &extra[f - world_mesh.count];
+        int i0, i1, j0, j1;
+        if (face_pixel_bounds(face, viewer, eye, I, J, &i0, &i1, &j0, &j1)) {
+            draw_face(face, eye, I, J, i0, i1, j0, j1,
+                      row_cos, row_sin, column_cos, column_sin, depth, hit);
+        }
+    }
+
+    double lod_distance[MAP_LOD_LEVELS];
+    lod_distances(I, J, lod_distance);
+    unsigned char saved[MAP_LOD_LEVELS];
+    lod_mark_viewer(viewer, saved);
+
+    for (int i = 0; i < I; i++) {
+        for (int j = 0; j < J; j++) {
+            int p = i * J + j;
+            const face_t* face = hit[p];
+            double dir[3] = {
+                row_cos[i] * column_cos[j],
+                row_cos[i] * column_sin[j],
+                row_sin[i]
+            };
+            ray_t ray;
+            if (face && depth[p] <= max_ray_lenght) {
+                // every unit step in front of the nearest face is in empty space, the ray
+                // engine takes over from the last one and lands where it would have alone
+                ray = cast_ray_from(viewer, row_angle(viewer, i, I), column_angle(viewer, j, J),
+                                    (int)depth[p], lod_distance, map_with_players_added, list);
+            } else {
+                // same place the ray engine gives up
+                double t = floor(max_ray_lenght) + 1;
+                ray.is_player = false;
+                ray.light = LIGHT_FULL;
+                ray.lenght = t;
+                ray.end_x = eye[0] + t * dir[0];
+                ray.end_y = eye[1] + t * dir[1];
+                ray.end_z = eye[2] + t * dir[2];
+                ray.color = SKY_COLOR;
+                list->rays_to_long_counter++;
+            }
+            ray.index = p;
+            store_ray(list, &ray);
+        }
+    }
+    lod_restore_viewer(viewer, saved);
+
+    free(depth);
+    free(hit);
+    free(angles);
+    free(extra);
+    return list;
+}
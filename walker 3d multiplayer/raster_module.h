@@ -0,0 +1,34 @@
+#ifndef RASTER_MODULE_H
+#define RASTER_MODULE_H
+
+#include "render_module.h"
+
+// Greedy-meshed, axis aligned face of the voxel world
+typedef struct {
+    int axis;    // 0: x, 1: y, 2: z
+    int normal;  // +1 or -1 along the axis
+    int type;    // OBSTACLE_TYPE, PLAYER_TYPE, MIRROR_TYPE or FOG_TYPE
+    int plane;   // coordinate of the face along the axis
+    int u0, u1;  // extent along the first other axis (x for axis 1 and 2, y for axis 0)
+    int v0, v1;  // extent along the second other axis (z for axis 0 and 1, y for axis 2)
+} face_t;
+
+typedef struct {
+    face_t* faces;
+    int count;
+    int capacity;
+} face_list_t;
+
+// Meshing
+void mesh_exposed_faces(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE], face_list_t* mesh);
+void free_face_list(face_list_t* mesh);
+
+// Rasterizes the visible faces of `map` and of the given players into the same G-buffer
+// create_rays produces. The nearest face only tells how far each ray can go without
+// hitting anything: the ray engine finishes the pixel from there, so both engines see the
+// same voxels, edges the unit steps slip past and mirrors included.
+rays_list_t* rasterize_frame(player_t* viewer, int I, int J,
+                             object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                             position_t* players, int player_count);
+
+#endif // RASTER_MODULE_H
@@ -0,0 +1,185 @@
+// Ray marching kernel, specialised at compile time.
+//
+// render_module.c includes this file once per combination of RENDER_* features with
+// RENDER_KERNEL_FEATURES set to the feature mask; it defines cast_ray_<mask> and
+// fill_rays_<mask>. Disabled features are preprocessed out of the marching loop.
+// No include guard on purpose.
+
+#define KERNEL_NAME(base) RENDER_CONCAT(base, RENDER_KERNEL_FEATURES)
+
+#if RENDER_KERNEL_FEATURES & RENDER_PLAYERS
+#define KERNEL_SOLID(type) ((type) == OBSTACLE_TYPE || (type) == PLAYER_TYPE)
+#else
+#define KERNEL_SOLID(type) ((type) == OBSTACLE_TYPE)
+#endif
+
+// the viewer only shows up in mirrors
+#define KERNEL_SEES_VIEWER ((RENDER_KERNEL_FEATURES & RENDER_PLAYERS) && \
+                            (RENDER_KERNEL_FEATURES & RENDER_REFLECTIONS))
+
+#if RENDER_KERNEL_FEATURES & RENDER_DEBUG
+#define KERNEL_COUNT(counter) (stats->counter++)
+#else
+#define KERNEL_COUNT(counter) ((void)0)
+#endif
+
+static ray_t KERNEL_NAME(cast_ray_)(player_t* viewer, double ZY_angle, double XY_angle,
+                                    int start_distance,
+                                    const double lod_distance[MAP_LOD_LEVELS],
+                                    object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                                    rays_list_t* stats) {
+    double dir_x = cos(ZY_angle) * cos(XY_angle);
+    double dir_y = cos(ZY_angle) * sin(XY_angle);
+    double dir_z = sin(ZY_angle);
+    double x = viewer->position.x + 0.5 + dir_x * start_distance;
+    double y = viewer->position.y + 0.5 + dir_y * start_distance;
+    double z = viewer->position.z + 0.5 + dir_z * start_distance;
+    // a resumed ray reached its first position by a unit step like any other
+    double dx = 0, dy = 0, dz = 0;
+    if (start_distance > 0) {
+        dx = dir_x;
+        dy = dir_y;
+        dz = dir_z;
+    }
+    double total_distance = start_distance;
+    int dx_dir = 1, dy_dir = 1, dz_dir = 1;
+    ray_t ray;
+    ray.index = 0;
+    ray.is_player = false;
+    ray.light = LIGHT_FULL;
+#if KERNEL_SEES_VIEWER
+    int viewer_x = (int)(viewer->position.x + 0.5);
+    int viewer_y = (int)(viewer->position.y + 0.5);
+    int viewer_z = (int)(viewer->position.z + 0.5);
+    bool is_reflected = false;
+#endif
+    while (true) {
+        KERNEL_COUNT(steps_counter);
+        if (total_distance > max_ray_lenght) {
+            KERNEL_COUNT(rays_to_long_counter);
+            ray.color = SKY_COLOR;
+            break;
+        }
+#if RENDER_KERNEL_FEATURES & RENDER_LOD
+        int lod_steps = lod_trace_step(x, y, z, dir_x * dx_dir, dir_y * dy_dir, dir_z * dz_dir,
+                                       total_distance, lod_distance, &ray.color);
+        if (lod_steps < 0) {
+            KERNEL_COUNT(rays_into_walls_counter);
+            break;
+        } else if (lod_steps > 0) {
+            // jump over the empty coarse cell, staying on the same unit-step lattice
+            int remaining = (int)(max_ray_lenght - total_distance) + 1;
+            if (lod_steps > remaining) lod_steps = remaining;
+            dx = dir_x * dx_dir;
+            dy = dir_y * dy_dir;
+            dz = dir_z * dz_dir;
+            total_distance += lod_steps;
+            x += dx * lod_steps;
+            y += dy * lod_steps;
+            z += dz * lod_steps;
+            continue;
+        }
+#endif
+        object_t* voxel = &map_with_players_added[(int)z][(int)y][(int)x];
+        if (KERNEL_SOLID(voxel->type)) {
+            KERNEL_COUNT(rays_into_walls_counter);
+            ray.color = voxel->color;
+            ray.light = voxel_light((int)x, (int)y, (int)z, entry_face(x, y, z, dx, dy, dz));
+            break;
+        }
+#if KERNEL_SEES_VIEWER
+        // a reflected ray that comes back to the viewer's cell shows the viewer
+        if (is_reflected && (int)x == viewer_x && (int)y == viewer_y && (int)z == viewer_z) {
+            ray.is_player = true;
+            KERNEL_COUNT(rays_into_player_counter);
+            ray.color = viewer->color;
+            break;
+        }
+#endif
+        if (voxel->type == FOG_TYPE) {
+            // not received yet, drawn like a ray that ran out of range
+            KERNEL_COUNT(rays_to_long_counter);
+            ray.color = SKY_COLOR;
+            total_distance = max_ray_lenght;
+            break;
+        }
+        if (voxel->type == MIRROR_TYPE) {
+#if RENDER_KERNEL_FEATURES & RENDER_REFLECTIONS
+#if KERNEL_SEES_VIEWER
+            is_reflected = true;
+#endif
+            double prev_x = x - dx;
+            double prev_y = y - dy;
+            double prev_z = z - dz;
+            if (mirror_collision(map_with_players_added, prev_x + dx, prev_y, prev_z)) dx_dir *= -1;
+            if (mirror_collision(map_with_players_added, prev_x, prev_y + dy, prev_z)) dy_dir *= -1;
+            if (mirror_collision(map_with_players_added, prev_x, prev_y, prev_z + dz)) dz_dir *= -1;
+            KERNEL_COUNT(mirrored_count);
+#else
+            // without reflections mirrors are plain opaque walls
+            KERNEL_COUNT(rays_into_walls_counter);
+            ray.color = MIRROR_COLOR;
+            ray.light = voxel_light((int)x, (int)y, (int)z, entry_face(x, y, z, dx, dy, dz));
+            break;
+#endif
+        }
+        dx = dir_x * dx_dir;
+        dy = dir_y * dy_dir;
+        dz = dir_z * dz_dir;
+        total_distance += 1;
+        x += dx;
+        y += dy;
+        z += dz;
+    }
+    ray.end_x = x;
+    ray.end_y = y;
+    ray.end_z = z;
+    ray.lenght = total_distance;
+    return ray;
+}
+
+static void KERNEL_NAME(fill_rays_)(player_t* viewer, rays_list_t* list,
+                                    const double lod_distance[MAP_LOD_LEVELS],
+                                    object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE]) {
+    int I = list->i;
+    int J = list->j;
+#if RENDER_KERNEL_FEATURES & RENDER_DEBUG
+    if (list->cost_ns) {
+        for (int i = 0; i < I; i++) {
+            double ZY_angle = row_angle(viewer, i, I);
+            for (int j = 0; j < J; j++) {
+                double XY_angle = column_angle(viewer, j, J);
+                int steps = list->steps_counter;
+                int bounces = list->mirrored_count;
+                double start = cost_clock_ns();
+                ray_t ray = KERNEL_NAME(cast_ray_)(viewer, ZY_angle, XY_angle, 0, lod_distance,
+                                                   map_with_players_added, list);
+                ray.index = i * J + j;
+                list->cost_ns[ray.index] = cost_clock_ns() - start;
+                steps = list->steps_counter - steps;
+                bounces = list->mirrored_count - bounces;
+                list->cost_steps[ray.index] = steps < 65535 ? steps : 65535;
+                list->cost_bounces[ray.index] = bounces < 255 ? bounces : 255;
+                store_ray(list, &ray);
+            }
+        }
+        return;
+    }
+#endif
+    for (int i = 0; i < I; i++) {
+        double ZY_angle = row_angle(viewer, i, I);
+        for (int j = 0; j < J; j++) {
+            double XY_angle = column_angle(viewer, j, J);
+            ray_t ray = KERNEL_NAME(cast_ray_)(viewer, ZY_angle, XY_angle, 0, lod_distance,
+                                               map_with_players_added, list);
+            ray.index = i * J + j;
+            store_ray(list, &ray);
+        }
+    }
+}
+
+#undef KERNEL_NAME
+#undef KERNEL_SOLID
+#undef KERNEL_COUNT
+#undef KERNEL_SEES_VIEWER
+#undef RENDER_KERNEL_FEATURES
@@ -0,0 +1,251 @@
+#include "render_module.h"
+#include "light_module.h"
+#include <math.h>
+#include <time.h>
+#include "alloc_module.h"
+
+const double max_ray_lenght = MAP_SIZE * 2;
+const double HEIGHT_ANGLE = M_PI / 4;
+const double VIEW_ANGLE = M_PI / 2;
+const double lod_bias = 1; // >1 switches rays to coarser LOD levels closer to the camera
+
+bool mirror_collision(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                      double pos_x, double pos_y, double pos_z) {
+    return map_to_use[(int)(pos_z)][(int)(pos_y)][(int)(pos_x)].type == MIRROR_TYPE;
+}
+
+bool player_colision(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                     double pos_x, double pos_y, double pos_z) {
+    return map_to_use[(int)(pos_z)][(int)(pos_y)][(int)(pos_x)].type == PLAYER_TYPE;
+}
+
+rays_list_t* alloc_rays(int I, int J) {
+    rays_list_t* list = malloc(sizeof(rays_list_t));
+    if (!list) return NULL;
+    // all planes share one block
+    list->depth = malloc((sizeof(float) + 3) * (I * J));
+    if (!list->depth) {
+        free(list);
+        return NULL;
+    }
+    list->flags = (unsigned char*)(list->depth + I * J);
+    list->color = list->flags + I * J;
+    list->light = list->color + I * J;
+    list->i = I;
+    list->j = J;
+    list->mirrored_count = 0;
+    list->rays_into_player_counter = 0;
+    list->rays_into_walls_counter = 0;
+    list->rays_to_long_counter = 0;
+    list->steps_counter = 0;
+    list->cost_ns = NULL;
+    list->cost_steps = NULL;
+    list->cost_bounces = NULL;
+    return list;
+}
+
+int alloc_cost_planes(rays_list_t* list) {
+    int count = list->i * list->j;
+    list->cost_ns = malloc((sizeof(float) + sizeof(unsigned short) + 1) * count);
+    if (!list->cost_ns) return -1;
+    list->cost_steps = (unsigned short*)(list->cost_ns + count);
+    list->cost_bounces = (unsigned char*)(list->cost_steps + count);
+    return 0;
+}
+
+void free_rays(rays_list_t* list) {
+    if (!list) return;
+    free(list->cost_ns);
+    free(list->depth);
+    free(list);
+}
+
+void store_ray(rays_list_t* list, ray_t* ray) {
+    int flags = 0;
+    if (ray->end_z < 1 || ray->end_z > MAP_HEIGHT - 1) flags |= SHADE_FLAG_SKY;
+    if (ray->is_player) flags |= SHADE_FLAG_PLAYER;
+    list->depth[ray->index] = ray->lenght;
+    list->flags[ray->index] = flags;
+    list->color[ray->index] = ray->color;
+    list->light[ray->index] = ray->light;
+}
+
+// Face through which the last unit step entered the voxel, -1 if it did not change voxels
+static int entry_face(double x, double y, double z, double dx, double dy, double dz) {
+    double pos[3] = {x, y, z};
+    double step[3] = {dx, dy, dz};
+    int face = -1;
+    double last_crossing = -1;
+    for (int axis = 0; axis < 3; axis++) {
+        double from = pos[axis] - step[axis];
+        int cell = (int)floor(pos[axis]);
+        if (cell == (int)floor(from)) continue;
+        double boundary = (step[axis] > 0) ? cell : cell + 1;
+        double crossing = (boundary - from) / step[axis];
+        if (crossing > last_crossing) {
+            last_crossing = crossing;
+            face = FACE_INDEX(axis, step[axis] > 0 ? -1 : 1);
+        }
+    }
+    return face;
+}
+
+double row_angle(player_t* viewer, int i, int I) {
+    return -HEIGHT_ANGLE / 2 + (((double)i + 1) / (double)I) * HEIGHT_ANGLE + viewer->angleZY;
+}
+
+double column_angle(player_t* viewer, int j, int J) {
+    return -VIEW_ANGLE / 2 + (((double)j + 1) / (double)J) * VIEW_ANGLE + viewer->angleXY;
+}
+
+// Distance from which one ray covers a whole cell of the LOD level
+void lod_distances(int I, int J, double lod_distance[MAP_LOD_LEVELS]) {
+    double pixel_angle = fmax(VIEW_ANGLE / J, HEIGHT_ANGLE / I);
+    for (int level = 0; level < MAP_LOD_LEVELS; level++) {
+        lod_distance[level] = (1 << level) / (pixel_angle * lod_bias);
+    }
+}
+
+static double lod_axis_exit(double pos, double step, int cell_start, int cell_size) {
+    if (step > 0) return (cell_start + cell_size - pos) / step;
+    if (step < 0) return (pos - cell_start) / -step;
+    return max_ray_lenght;
+}
+
+// Walks the LOD pyramid top-down at the ray position. Returns how many unit steps the ray
+// can skip through empty space, 0 when the position must be resolved at full resolution,
+// or -1 when the ray is far enough for a mostly solid coarse cell to stop it.
+int lod_trace_step(double x, double y, double z, double step_x, double step_y, double step_z,
+                   double total_distance, const double lod_distance[MAP_LOD_LEVELS], int* color) {
+    for (int level = MAP_LOD_LEVELS - 1; level > 0; level--) {
+        int cell_x = (int)x >> level;
+        int cell_y = (int)y >> level;
+        int cell_z = (int)z >> level;
+        lod_cell_t* cell = map_lod_cell(level, cell_x, cell_y, cell_z);
+        if (cell->flags) {
+            continue;
+        }
+        if (cell->occupancy == LOD_SOLID && total_distance >= lod_distance[level]) {
+            *color = cell->color;
+            return -1;
+        }
+        if (cell->occupancy != LOD_EMPTY) {
+            continue;
+        }
+        int size = 1 << level;
+        double t_exit = lod_axis_exit(x, step_x, cell_x * size, size);
+        t_exit = fmin(t_exit, lod_axis_exit(y, step_y, cell_y * size, size));
+        t_exit = fmin(t_exit, lod_axis_exit(z, step_z, cell_z * size, size));
+        // a whole t_exit already lands on the cell past a positive step's boundary
+        int steps = (int)ceil(t_exit);
+        return steps > 0 ? steps : 1;
+    }
+    return 0;
+}
+
+// The viewer is not in the map, but a reflected ray must not skip over its cell
+void lod_mark_viewer(player_t* viewer, unsigned char saved[MAP_LOD_LEVELS]) {
+    map_lod_push_player((int)(viewer->position.x + 0.5), (int)(viewer->position.y + 0.5),
+                        (int)(viewer->position.z + 0.5), saved);
+}
+
+void lod_restore_viewer(player_t* viewer, const unsigned char saved[MAP_LOD_LEVELS]) {
+    map_lod_pop_player((int)(viewer->position.x + 0.5), (int)(viewer->position.y + 0.5),
+                       (int)(viewer->position.z + 0.5), saved);
+}
+
+static double cost_clock_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// One specialised kernel per feature mask, see render_kernel.h
+#define RENDER_CONCAT_(a, b) a##b
+#define RENDER_CONCAT(a, b) RENDER_CONCAT_(a, b)
+
+#define RENDER_KERNEL_FEATURES 0
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 1
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 2
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 3
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 4
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 5
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 6
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 7
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 8
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 9
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 10
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 11
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 12
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 13
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 14
+#include "render_kernel.h"
+#define RENDER_KERNEL_FEATURES 15
+#include "render_kernel.h"
+
+typedef void (*fill_rays_t)(player_t* viewer, rays_list_t* list,
+                            const double lod_distance[MAP_LOD_LEVELS],
+                            object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE]);
+
+static const fill_rays_t fill_rays_kernels[RENDER_ALL + 1] = {
+    fill_rays_0, fill_rays_1, fill_rays_2, fill_rays_3,
+    fill_rays_4, fill_rays_5, fill_rays_6, fill_rays_7,
+    fill_rays_8, fill_rays_9, fill_rays_10, fill_rays_11,
+    fill_rays_12, fill_rays_13, fill_rays_14, fill_rays_15
+};
+
+ray_t cast_ray(player_t* viewer, double ZY_angle, double XY_angle,
+               const double lod_distance[MAP_LOD_LEVELS],
+               object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+               rays_list_t* stats) {
+    return cast_ray_15(viewer, ZY_angle, XY_angle, 0, lod_distance, map_with_players_added, stats);
+}
+
+ray_t cast_ray_from(player_t* viewer, double ZY_angle, double XY_angle, int start_distance,
+                    const double lod_distance[MAP_LOD_LEVELS],
+                    object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                    rays_list_t* stats) {
+    return cast_ray_15(viewer, ZY_angle, XY_angle, start_distance, lod_distance,
+                       map_with_players_added, stats);
+}
+
+rays_list_t* create_rays_with(player_t* viewer, int I, int J,
+                              object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                              int features) {
+    rays_list_t* list = alloc_rays(I, J);
+    if (!list) return NULL;
+    if (features & RENDER_COST) {
+        if (alloc_cost_planes(list) != 0) {
+            free_rays(list);
+            return NULL;
+        }
+        features |= RENDER_DEBUG;
+    }
+
+    double lod_distance[MAP_LOD_LEVELS];
+    lod_distances(I, J, lod_distance);
+    unsigned char saved[MAP_LOD_LEVELS];
+    lod_mark_viewer(viewer, saved);
+    fill_rays_kernels[features & RENDER_ALL](viewer, list, lod_distance, map_with_players_added);
+    lod_restore_viewer(viewer, saved);
+    return list;
+}
+
+rays_list_t* create_rays(player_t* viewer, int I, int J,
+                         object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE]) {
+    return create_rays_with(viewer, I, J, map_with_players_added, RENDER_ALL);
+}
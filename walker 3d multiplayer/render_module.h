@@ -0,0 +1,109 @@
+#ifndef RENDER_MODULE_H
+#define RENDER_MODULE_H
+
+#include <stdbool.h>
+#include "map_module.h"
+#include "shade_module.h"
+
+// Render engines
+#define ENGINE_RAYS 0
+#define ENGINE_RASTER 1
+
+// Color of rays that run out of length (COLOR_WHITE)
+#define SKY_COLOR 7
+// Color of mirrors when reflections are off (COLOR_WHITE)
+#define MIRROR_COLOR 7
+
+// Ray kernel features, every combination is compiled into its own kernel
+#define RENDER_REFLECTIONS 1 // mirrors reflect rays instead of being opaque
+#define RENDER_PLAYERS 2     // other players' voxels are solid, mirrors show the viewer
+#define RENDER_DEBUG 4       // rays_list_t counters are written
+#define RENDER_LOD 8         // empty space skipping and far solid cells through the LOD pyramid
+#define RENDER_ALL (RENDER_REFLECTIONS | RENDER_PLAYERS | RENDER_DEBUG | RENDER_LOD)
+
+// Not a kernel variant: also fills the per-ray cost planes, implies RENDER_DEBUG
+#define RENDER_COST 16
+
+// Plain unit-step marcher, what optimised paths are validated against
+#define RENDER_REFERENCE (RENDER_REFLECTIONS | RENDER_PLAYERS)
+
+typedef struct ray {
+    double end_x;
+    double end_y;
+    double end_z;
+    int index;
+    double lenght;
+    bool is_player;
+    int color;
+    unsigned char light; // baked light of the face that was hit
+} ray_t;
+
+// G-buffer: one entry per screen cell in every plane
+typedef struct rays_list {
+    float* depth;
+    unsigned char* flags; // SHADE_FLAG_*
+    unsigned char* color;
+    unsigned char* light;
+    int i; // rays in height
+    int j; // rays in width
+
+    // debug puposes
+    int mirrored_count;
+    int rays_into_walls_counter;
+    int rays_into_player_counter;
+    int rays_to_long_counter;
+    int steps_counter; // marching loop iterations, LOD jumps count as one
+
+    // per-ray cost planes, only allocated for RENDER_COST frames of the ray engine
+    float* cost_ns;
+    unsigned short* cost_steps;
+    unsigned char* cost_bounces;
+} rays_list_t;
+
+// View settings
+extern const double max_ray_lenght;
+extern const double HEIGHT_ANGLE;
+extern const double VIEW_ANGLE;
+extern const double lod_bias;
+
+// Collisions against a map that may have other players added (wall_collision is in
+// map_module.h, the server moves players too)
+bool mirror_collision(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                      double pos_x, double pos_y, double pos_z);
+bool player_colision(object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                     double pos_x, double pos_y, double pos_z);
+
+// G-buffer
+rays_list_t* alloc_rays(int I, int J);
+void free_rays(rays_list_t* list);
+void store_ray(rays_list_t* list, ray_t* ray);
+int alloc_cost_planes(rays_list_t* list);
+
+// Ray engine
+void lod_distances(int I, int J, double lod_distance[MAP_LOD_LEVELS]);
+void lod_mark_viewer(player_t* viewer, unsigned char saved[MAP_LOD_LEVELS]);
+void lod_restore_viewer(player_t* viewer, const unsigned char saved[MAP_LOD_LEVELS]);
+int lod_trace_step(double x, double y, double z, double step_x, double step_y, double step_z,
+                   double total_distance, const double lod_distance[MAP_LOD_LEVELS], int* color);
+ray_t cast_ray(player_t* viewer, double ZY_angle, double XY_angle,
+               const double lod_distance[MAP_LOD_LEVELS],
+               object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+               rays_list_t* stats);
+// The same ray, marched from its `start_distance`th unit step on. The steps before it must
+// all be in empty voxels.
+ray_t cast_ray_from(player_t* viewer, double ZY_angle, double XY_angle, int start_distance,
+                    const double lod_distance[MAP_LOD_LEVELS],
+                    object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                    rays_list_t* stats);
+// create_rays uses every feature, create_rays_with only the RENDER_* ones in `features`
+rays_list_t* create_rays(player_t* viewer, int I, int J,
+                         object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE]);
+rays_list_t* create_rays_with(player_t* viewer, int I, int J,
+                              object_t map_with_players_added[MAP_HEIGHT][MAP_SIZE][MAP_SIZE],
+                              int features);
+
+// Pixel -> view angle mapping shared by both engines
+double row_angle(player_t* viewer, int i, int I);
+double column_angle(player_t* viewer, int j, int J);
+
+#endif // RENDER_MODULE_H
@@ -2,8 +2,15 @@
 #include <stdlib.h>
 #include <math.h> 
 #include <string.h>
+#include <signal.h>
+#include <time.h>
 #include <enet/enet.h>
 #include "../map_module.h"
+#include "../profile_module.h"
+#include "../protocol_module.h"
+#include "../movement_module.h"
+#include "../snapshot_module.h"
+#include "../alloc_module.h"
 
 #define MAP_SIZE 40
 #define MAP_HEIGHT 20
@@ -11,6 +18,12 @@
 #define MAX_CLIENTS 64
 #define SERVER_PORT 1111
 #define CHANEL_COUNT 64
+#define DEFAULT_JOIN_RATE 20 // joins admitted per second, 0 admits every join at once
+#define JOIN_HASHES_TIMEOUT_MS 1000 // a JOIN_WITH_HASHES peer gets the full world after this
+#define DEFAULT_STREAM_RATE 16384 // world bytes per second to a joined peer, 0 sends it whole
+#define STREAM_PACKET_BYTES 1200  // chunks per stream packet, about one ENet fragment
+#define JOIN_NEAR_BYTES 4096      // sent on admission, the chunks around the spawn point
+#define DEFAULT_TICK_RATE 30      // ticks per second, each sends every client one world state
 
 #define PLAYER_UPDATE_EVENT 1
 #define MAP_UPDATE_EVENT 2
@@ -31,23 +44,139 @@ const int OUTCOME_NEW_PLAYER_POSITION = 4;
 
 // income
 const int INCOME_PLAYER_UPDATED_CHANEL = 2;
+const int INCOME_VOXEL_EDITS_CHANEL = 5;
+const int INCOME_RESYNC_CHANEL = 6;
+const int INCOME_STATE_ACK_CHANEL = 7;
 
 position_t spawn_point;
 player_t players[MAX_CLIENTS];
+bool joined[MAX_CLIENTS]; // sent the world and a player, by incomingPeerID
+static ENetPeer* player_peers[MAX_CLIENTS]; // of the joined players
+
+// The server runs in ticks. Between two of them the players' commands move `players`, the
+// positions are the server's own and never taken from a client, and every tick sends each
+// client a single world state with all players: the bandwidth per client is tick_rate
+// states of at most WORLD_STATE_MAX_SIZE bytes, whatever the clients send.
+static int tick_rate = DEFAULT_TICK_RATE;
+static int tick = 0;
+// States of the last ticks, by tick % WORLD_STATE_HISTORY. A client's state is encoded
+// against the newest one it acknowledged, so it carries only the players that changed.
+static world_state_t state_history[WORLD_STATE_HISTORY];
+static int acked_ticks[MAX_CLIENTS]; // -1 before the first acknowledgement
+static int input_acks[MAX_CLIENTS];  // sequence of the newest command run, 0 before any
+
+// Connected peers waiting for the world. Joins are admitted from a token bucket
+// refilled at join_rate per second, holding at most one second of joins, so a join storm
+// is spread over several passes instead of stalling everybody's movement.
+static ENetPeer* join_queue[MAX_CLIENTS];
+static int join_queue_length = 0;
+static int join_rate = DEFAULT_JOIN_RATE;
+static double join_tokens = 0;
+static double join_refilled_ms = 0;
+// Peers that connected with JOIN_WITH_HASHES wait for their resync request, so they are
+// sent only the chunks their cached world lacks
+static bool join_expects_hashes[MAX_CLIENTS];
+static unsigned char join_hashes[MAX_CLIENTS][RESYNC_REQUEST_SIZE];
+static size_t join_hashes_size[MAX_CLIENTS];
+static double join_connected_ms[MAX_CLIENTS];
+
+// The world snapshot every joiner gets. The server holds one reference, so ENet keeps the
+// packet after sending it and all joiners share it; it is re-encoded only when
+// map_version moves on.
+static ENetPacket* snapshot_packet = NULL;
+static unsigned int snapshot_version = 0;
+static size_t snapshot_chunk_offsets[MAP_CHUNK_COUNT];
+static size_t snapshot_chunk_sizes[MAP_CHUNK_COUNT];
+
+// Joined peers get the world chunk by chunk, nearest to the spawn point first, copied out
+// of the shared snapshot. JOIN_NEAR_BYTES go at once, the rest at stream_rate bytes per
+// second. Streams use the map channel, so chunks and deltas arrive in the order they
+// were made.
+static int stream_rate = DEFAULT_STREAM_RATE;
+static int stream_order[MAP_CHUNK_COUNT];
+static ENetPeer* stream_peers[MAX_CLIENTS]; // NULL when not streaming
+static int stream_next[MAX_CLIENTS];        // position in stream_order
+static double stream_tokens[MAX_CLIENTS];
+static double stream_refilled_ms = 0;
+
+// Edits applied since the last delta broadcast, which goes out once per loop pass on the
+// map channel, so it stays ordered with the snapshots
+static voxel_edit_t delta_edits[MAX_VOXEL_EDITS];
+static int delta_edit_count = 0;
+static unsigned int delta_base_version = 0; // map_version before the first of them
+
+// SIGUSR1 writes the --profile trace from the main loop
+static volatile sig_atomic_t profile_requested = 0;
+
+static void request_profile(int signal_number) {
+    (void)signal_number;
+    profile_requested = 1;
+}
+
+// SIGINT leaves the main loop, so the host is destroyed and exit reports run
+static volatile sig_atomic_t running = 1;
+
+static void stop_server(int signal_number) {
+    (void)signal_number;
+    running = 0;
+}
 
 void init_player(player_t* player);
 ENetHost* create_game_server();
 void add_random_obsticles();
 void print_packet_hex(ENetPacket* packet);
 
-void send_data_to_new_player(player_t* new_player, ENetEvent* event, ENetHost* server);
-void send_player_position_update_data(player_t* player, ENetHost* server, int index);
+double server_clock_ms();
+ENetPacket* world_snapshot_packet();
+void release_snapshot_packet();
+void queue_join(ENetPeer* peer);
+void drop_queued_join(ENetPeer* peer);
+int admit_queued_joins(ENetHost* server);
+void apply_player_edits(ENetPacket* packet, int player_index);
+void broadcast_map_delta();
+bool send_chunks(const int* chunks, int count, ENetPeer* peer);
+bool answer_resync_request(const unsigned char* request, size_t size, ENetPeer* peer);
+void answer_chunk_request(const unsigned char* request, size_t size, ENetPeer* peer);
+void sort_stream_order();
+void start_world_stream(ENetPeer* peer);
+void stream_world_to(ENetPeer* peer);
+void stream_world();
+
+void send_data_to_new_player(player_t* new_player, ENetPeer* peer, ENetHost* server);
+void send_world_states();
+void run_player_commands(ENetPacket* packet, int player_index);
 
 int main(int argc, char** argv) {
-    
+    const char* profile_name = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--profile=", 10) == 0) {
+            profile_name = argv[i] + 10;
+        } else if (strncmp(argv[i], "--join-rate=", 12) == 0) {
+            join_rate = atoi(argv[i] + 12);
+        } else if (strncmp(argv[i], "--stream-rate=", 14) == 0) {
+            stream_rate = atoi(argv[i] + 14);
+        } else if (strncmp(argv[i], "--tick-rate=", 12) == 0) {
+            tick_rate = atoi(argv[i] + 12);
+        } else {
+            fprintf(stderr, "Usage: %s [--profile=TRACE_JSON] [--join-rate=JOINS_PER_SECOND] "
+                            "[--stream-rate=BYTES_PER_SECOND] [--tick-rate=HZ]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (tick_rate < 1 || tick_rate > 255) {
+        fprintf(stderr, "The tick rate must be 1 to 255 Hz\n");
+        return EXIT_FAILURE;
+    }
+    if (profile_name) {
+        profile_enable(true);
+        signal(SIGUSR1, request_profile);
+        printf("Profiling, send SIGUSR1 to write %s\n", profile_name);
+    }
+
     spawn_point.x = 12;
     spawn_point.y = 19;
     spawn_point.z = MAP_HEIGHT / 2;
+    sort_stream_order();
 
     ENetHost* server = create_game_server();
 
@@ -60,42 +189,83 @@ int main(int argc, char** argv) {
 
     initialize_map();
     printf("Map initialised\n");
-
-    while (1) {
+    signal(SIGINT, stop_server);
+
+    double tick_period_ms = 1000.0 / tick_rate;
+    double next_tick_ms = server_clock_ms();
+    while (running) {
+        if (profile_requested) {
+            profile_requested = 0;
+            profile_export_chrome(profile_name, "server");
+        }
         ENetEvent event;
-        // Wait up to 10000 ms for an event.
-        while (enet_host_service(server, &event, 0) > 0) {
+        alloc_frame_begin();
+        // events until the tick is due, sleeping in enet_host_service between them
+        int wait_ms;
+        while ((wait_ms = (int)ceil(next_tick_ms - server_clock_ms())) > 0 &&
+               enet_host_service(server, &event, wait_ms) > 0) {
             switch (event.type) {
-                case ENET_EVENT_TYPE_CONNECT: 
+                case ENET_EVENT_TYPE_CONNECT: {
                     GLOBAL_PLAYER_COUNT++;
                     printf("A new client connected from %x:%u.\n", event.peer->address.host, event.peer->address.port);
                     fflush(stdout); 
-
-                    // Initialize the client's state:
-                    player_t new_player;
-                    init_player(&new_player);
-                    
-                    send_data_to_new_player(&new_player, &event, server);
-                    send_player_position_update_data(&new_player, server, event.peer->incomingPeerID);
+                    int id = event.peer->incomingPeerID;
+                    join_expects_hashes[id] = event.data == JOIN_WITH_HASHES;
+                    join_hashes_size[id] = 0;
+                    join_connected_ms[id] = server_clock_ms();
+                    queue_join(event.peer);
                     break;
+                }
 
                 case ENET_EVENT_TYPE_RECEIVE: 
                     switch (event.channelID) {
-                    case INCOME_PLAYER_UPDATED_CHANEL:
-                        printf("Player %d send an update: %s\n", event.peer->incomingPeerID, event.packet->data);
-                        player_t* update_from_player = malloc(sizeof(player_t));
-                        int update_result = deserialize_player(event.packet->data, update_from_player);
-                        if(update_result == -1) {
-                            printf("Failed to deserialise player data\n");
-                            free(update_from_player);
-                            break;
+                    case INCOME_PLAYER_UPDATED_CHANEL: {
+                        PROFILE_SPAN("player commands");
+                        if (joined[event.peer->incomingPeerID]) {
+                            run_player_commands(event.packet, event.peer->incomingPeerID);
                         }
-
-                        players[event.peer->incomingPeerID] = *update_from_player;
-                        send_player_position_update_data(update_from_player, server, event.peer->incomingPeerID);
                         break;
+                    }
+                    case INCOME_VOXEL_EDITS_CHANEL: {
+                        PROFILE_SPAN("voxel edits");
+                        if (joined[event.peer->incomingPeerID]) {
+                            apply_player_edits(event.packet, event.peer->incomingPeerID);
+                        }
+                        break;
+                    }
+                    case INCOME_STATE_ACK_CHANEL: {
+                        int id = event.peer->incomingPeerID;
+                        int acked;
+                        if (joined[id] &&
+                            decode_state_ack(event.packet->data, event.packet->dataLength,
+                                             &acked) == 0 &&
+                            (acked_ticks[id] < 0 || sequence_newer(acked, acked_ticks[id]))) {
+                            acked_ticks[id] = acked;
+                        }
+                        break;
+                    }
+                    case INCOME_RESYNC_CHANEL: {
+                        PROFILE_SPAN("resync");
+                        int id = event.peer->incomingPeerID;
+                        int type = message_type(event.packet->data, event.packet->dataLength);
+                        if (joined[id] && type == MESSAGE_RESYNC_REQUEST) {
+                            answer_resync_request(event.packet->data, event.packet->dataLength,
+                                                  event.peer);
+                        } else if (joined[id] && type == MESSAGE_CHUNK_REQUEST) {
+                            answer_chunk_request(event.packet->data, event.packet->dataLength,
+                                                 event.peer);
+                        } else if (!joined[id] && join_expects_hashes[id] &&
+                                   type == MESSAGE_RESYNC_REQUEST &&
+                                   event.packet->dataLength <= RESYNC_REQUEST_SIZE) {
+                            // the hashes of a queued join with a cached world, used once
+                            // it is admitted
+                            memcpy(join_hashes[id], event.packet->data, event.packet->dataLength);
+                            join_hashes_size[id] = event.packet->dataLength;
+                        }
+                        break;
+                    }
                     default:
-                        printf("Unrecognisable event from chanel %d, data: %s\n", event.channelID, event.packet->data);
+                        printf("Unrecognisable event from chanel %d of %zu bytes\n", event.channelID, event.packet->dataLength);
                         break;
                     }
                     break;
@@ -103,6 +273,10 @@ int main(int argc, char** argv) {
                 case ENET_EVENT_TYPE_DISCONNECT: 
                     GLOBAL_PLAYER_COUNT--;
                     printf("Client disconnected.\n");
+                    joined[event.peer->incomingPeerID] = false;
+                    player_peers[event.peer->incomingPeerID] = NULL;
+                    stream_peers[event.peer->incomingPeerID] = NULL;
+                    drop_queued_join(event.peer);
                     // Clean up any client-specific data
                     free(event.peer->data);
                     event.peer->data = NULL;
@@ -112,62 +286,44 @@ int main(int argc, char** argv) {
                     break;
             }
         }
+        if (server_clock_ms() < next_tick_ms) {
+            continue; // interrupted by a signal
+        }
+        // a server that fell behind skips the ticks it missed rather than running them late
+        next_tick_ms += tick_period_ms;
+        if (next_tick_ms < server_clock_ms()) next_tick_ms = server_clock_ms() + tick_period_ms;
+
+        PROFILE_SPAN("tick");
+        admit_queued_joins(server);
+        broadcast_map_delta();
+        stream_world();
+        send_world_states();
+        tick++;
+        alloc_frame_end();
     }
 
     enet_host_destroy(server);
+    release_snapshot_packet();
     printf("server was destroyed");
     return 0;
 }
 
-void send_player_position_update_data(player_t* player, ENetHost* server, int index) {
-    player_position_t* pos_to_feed = malloc(sizeof(player_position_t));
-    pos_to_feed->x = player->position.x;
-    pos_to_feed->y = player->position.y;
-    pos_to_feed->z = player->position.z;
-
-    pos_to_feed->index = index;
-
-    char* serialised_pos = serialize_player_positions(pos_to_feed);
-    printf("serialised_pos: %s\n", serialised_pos);
-
-    ENetPacket* packet = enet_packet_create(serialised_pos, 
-                                            strlen(serialised_pos), 
-                                            ENET_PACKET_FLAG_RELIABLE);
-    printf("send new_player_position data of size: %zu\n", strlen(serialised_pos));
-    enet_host_broadcast(server, OUTCOME_NEW_PLAYER_POSITION, packet);
-    printf("%s\n", serialised_pos);
-}
-
-void send_data_to_new_player(player_t* new_player, ENetEvent* event, ENetHost* server) {
-        players[event->peer->incomingPeerID] = *new_player;
-
-        char* serialised_map = serialize_map(map);
-        // sending the world to peer
-        ENetPacket* map_packet = enet_packet_create(serialised_map, 
-                                                strlen(serialised_map), 
-                                                ENET_PACKET_FLAG_RELIABLE);
-        printf("send world data to peer of size: %zu\n", sizeof(map));
-        enet_peer_send(event->peer, OUTCOME_MAP_UPDATES_CHANEL, map_packet);
-        // print_packet_hex(map_packet);
-        printf("serialised map: %s\n", serialised_map);
-        for (int i = 0; i < MAP_SIZE; i++) {
-            for (int j = 0; j < MAP_SIZE; j++) {
-                printf("%d", map[0][i][j].type);
-            }
-            printf("\n");
-        }
-        printf("\n");
+void send_data_to_new_player(player_t* new_player, ENetPeer* peer, ENetHost* server) {
+        players[peer->incomingPeerID] = *new_player;
+        joined[peer->incomingPeerID] = true;
+        player_peers[peer->incomingPeerID] = peer;
+        acked_ticks[peer->incomingPeerID] = -1;
+        input_acks[peer->incomingPeerID] = 0;
 
         // sending a new player to peer
-        char* serialised_player = serialize_player(new_player);
-        ENetPacket* player_packet = enet_packet_create(serialised_player, 
-                                                strlen(serialised_player), 
+        unsigned char player_message[PLAYER_MESSAGE_SIZE];
+        int player_message_size = encode_player(new_player, player_message, sizeof(player_message));
+        ENetPacket* player_packet = enet_packet_create(player_message, player_message_size,
                                                 ENET_PACKET_FLAG_RELIABLE);
-        printf("send player data to peer of size: %zu\n", strlen(serialised_player));
-        printf("data: %s\n", serialised_player);
+        printf("send player data to peer of size: %d\n", player_message_size);
         printf("player: x: %f, y: %f, z: %f, xy: %f, zy: %f color: %d\n",
                  new_player->position.x, new_player->position.y, new_player->position.z, new_player->angleXY, new_player->angleZY, new_player->color);
-        enet_peer_send(event->peer, OUTCOME_NEW_PLAYER_CHANEL, player_packet);
+        enet_peer_send(peer, OUTCOME_NEW_PLAYER_CHANEL, player_packet);
         print_packet_hex(player_packet);
 
         // sending a other_players to peer
@@ -176,14 +332,330 @@ void send_data_to_new_player(player_t* new_player, ENetEvent* event, ENetHost* s
         for (int i = 0; i < 64; i++) {
             other_players[i] = players[i].position;
         }
-        char* serialised_positions = serialize_positions(other_players, GLOBAL_PLAYER_COUNT);
-        ENetPacket* player_positions_data_packet = enet_packet_create(serialised_positions, 
-                                                strlen(serialised_positions), 
+        unsigned char positions_message[POSITIONS_MESSAGE_SIZE(MAX_CLIENTS)];
+        int positions_message_size = encode_positions(other_players, GLOBAL_PLAYER_COUNT,
+                                                      positions_message, sizeof(positions_message));
+        ENetPacket* player_positions_data_packet = enet_packet_create(positions_message,
+                                                positions_message_size,
                                                 ENET_PACKET_FLAG_RELIABLE);
-        printf("send players positions data to peer of size: %zu\n", strlen(player_positions_data_packet));
-        printf("data: %s\n", player_positions_data_packet);
-        enet_peer_send(event->peer, OUTCOME_LIST_OF_PLAYERS_CHANEL, player_positions_data_packet);
+        printf("send players positions data to peer of size: %d\n", positions_message_size);
+        enet_peer_send(peer, OUTCOME_LIST_OF_PLAYERS_CHANEL, player_positions_data_packet);
         print_packet_hex(player_positions_data_packet);
+
+        // the world last, so the player can move before it is complete: what a cached
+        // world lacks, or a stream of all chunks
+        int id = peer->incomingPeerID;
+        if (join_hashes_size[id] > 0 &&
+            answer_resync_request(join_hashes[id], join_hashes_size[id], peer)) {
+            return;
+        }
+        if (stream_rate > 0) {
+            start_world_stream(peer);
+            return;
+        }
+        ENetPacket* map_packet = world_snapshot_packet();
+        if (map_packet) {
+            enet_peer_send(peer, OUTCOME_MAP_UPDATES_CHANEL, map_packet);
+        } else {
+            printf("Cannot encode the world snapshot\n");
+        }
+}
+
+// Movement goes out unreliable: a lost state is never resent, the next tick replaces it.
+// A state is only encoded against one the client acknowledged, so losses never leave the
+// client without its baseline; an acknowledgement older than the history means a full state.
+void send_world_states() {
+    PROFILE_SPAN("world states");
+    world_state_t* state = &state_history[tick % WORLD_STATE_HISTORY];
+    state->tick = tick & 0xffff;
+    state->tick_rate = tick_rate;
+    for (int id = 0; id < MAX_CLIENTS; id++) {
+        state->players[id].present = joined[id];
+        if (joined[id]) quantize_position(&players[id].position, &state->players[id]);
+    }
+
+    unsigned char message[WORLD_STATE_MAX_SIZE];
+    for (int id = 0; id < MAX_CLIENTS; id++) {
+        if (!joined[id]) continue;
+        const world_state_t* baseline = NULL;
+        if (acked_ticks[id] >= 0 && ((tick - acked_ticks[id]) & 0xffff) < WORLD_STATE_HISTORY &&
+            state_history[acked_ticks[id] % WORLD_STATE_HISTORY].tick == acked_ticks[id]) {
+            baseline = &state_history[acked_ticks[id] % WORLD_STATE_HISTORY];
+        }
+        state->own_index = id;
+        state->input_ack = input_acks[id];
+        int message_size = encode_world_state(state, baseline, message, sizeof(message));
+        if (message_size < 0) {
+            printf("Cannot encode the world state for player %d\n", id);
+            continue;
+        }
+        enet_peer_send(player_peers[id], OUTCOME_NEW_PLAYER_POSITION,
+                       enet_packet_create(message, message_size, 0));
+    }
+}
+
+// Commands come again until acknowledged, only the ones newer than the last run count
+void run_player_commands(ENetPacket* packet, int player_index) {
+    input_command_t commands[INPUT_COMMANDS_MAX];
+    int count = decode_input_commands(packet->data, packet->dataLength, commands,
+                                      INPUT_COMMANDS_MAX);
+    if (count < 0) {
+        printf("Failed to decode the commands of player %d\n", player_index);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!sequence_newer(commands[i].sequence, input_acks[player_index])) continue;
+        if (is_movement_key(commands[i].key)) apply_input(&players[player_index], &commands[i]);
+        input_acks[player_index] = commands[i].sequence;
+    }
+}
+
+void apply_player_edits(ENetPacket* packet, int player_index) {
+    voxel_edit_t edits[MAX_VOXEL_EDITS];
+    int count = decode_voxel_edits(packet->data, packet->dataLength, edits, MAX_VOXEL_EDITS);
+    if (count < 0) {
+        printf("Failed to decode voxel edits from %d\n", player_index);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        unsigned int version = map_version;
+        if (!apply_voxel_edit(&edits[i])) {
+            printf("Player %d sent an invalid edit at %d|%d|%d\n", player_index,
+                   edits[i].x, edits[i].y, edits[i].z);
+            continue;
+        }
+        if (delta_edit_count == MAX_VOXEL_EDITS) {
+            broadcast_map_delta();
+        }
+        if (delta_edit_count == 0) {
+            delta_base_version = version;
+        }
+        delta_edits[delta_edit_count++] = edits[i];
+    }
+}
+
+void broadcast_map_delta() {
+    if (delta_edit_count == 0) return;
+    PROFILE_SPAN("broadcast map delta");
+    unsigned char message[MAP_DELTA_MESSAGE_SIZE(MAX_VOXEL_EDITS)];
+    int message_size = encode_map_delta(delta_base_version, map_version, delta_edits,
+                                        delta_edit_count, message, sizeof(message));
+    delta_edit_count = 0;
+    if (message_size < 0) return;
+    // queued joins get the world once admitted, through the stream
+    ENetPacket* packet = NULL;
+    for (int id = 0; id < MAX_CLIENTS; id++) {
+        if (!joined[id]) continue;
+        if (!packet) {
+            packet = enet_packet_create(message, message_size, ENET_PACKET_FLAG_RELIABLE);
+            if (!packet) return;
+        }
+        enet_peer_send(player_peers[id], OUTCOME_MAP_UPDATES_CHANEL, packet);
+    }
+}
+
+// A snapshot of only the listed chunks, empty ones still tell the world version
+bool send_chunks(const int* chunks, int count, ENetPeer* peer) {
+    ENetPacket* packet = enet_packet_create(NULL, SNAPSHOT_MAX_SIZE, ENET_PACKET_FLAG_RELIABLE);
+    if (!packet) return false;
+    int snapshot_size = encode_map_chunks(chunks, count, packet->data, SNAPSHOT_MAX_SIZE);
+    if (snapshot_size < 0) {
+        enet_packet_destroy(packet);
+        return false;
+    }
+    enet_packet_resize(packet, snapshot_size);
+    printf("resync of player %d: %d of %d chunks, %d bytes\n", peer->incomingPeerID, count,
+           MAP_CHUNK_COUNT, snapshot_size);
+    enet_peer_send(peer, OUTCOME_MAP_UPDATES_CHANEL, packet);
+    return true;
+}
+
+// First step of a resync: the chunk hashes under the subtrees whose hashes differ, or an
+// empty snapshot when the worlds match
+bool answer_resync_request(const unsigned char* request, size_t size, ENetPeer* peer) {
+    int subtrees[MAP_SUBTREE_COUNT];
+    int count = differing_subtrees(request, size, subtrees, MAP_SUBTREE_COUNT);
+    if (count < 0) {
+        printf("Malformed resync request from %d\n", peer->incomingPeerID);
+        return false;
+    }
+    if (count == 0) return send_chunks(NULL, 0, peer);
+    unsigned char message[CHUNK_HASHES_MAX_SIZE];
+    int message_size = encode_chunk_hashes(subtrees, count, message, sizeof(message));
+    if (message_size < 0) return false;
+    ENetPacket* packet = enet_packet_create(message, message_size, ENET_PACKET_FLAG_RELIABLE);
+    if (!packet) return false;
+    enet_peer_send(peer, OUTCOME_MAP_UPDATES_CHANEL, packet);
+    return true;
+}
+
+// Second step: the chunks the client found different
+void answer_chunk_request(const unsigned char* request, size_t size, ENetPeer* peer) {
+    int chunks[MAP_CHUNK_COUNT];
+    int count = decode_chunk_request(request, size, chunks, MAP_CHUNK_COUNT);
+    if (count < 0) {
+        printf("Malformed chunk request from %d\n", peer->incomingPeerID);
+        return;
+    }
+    send_chunks(chunks, count, peer);
+}
+
+// Chunks by distance of their centre to the spawn point
+void sort_stream_order() {
+    double distances[MAP_CHUNK_COUNT];
+    for (int chunk = 0; chunk < MAP_CHUNK_COUNT; chunk++) {
+        int x0, y0, z0, x1, y1, z1;
+        map_chunk_bounds(chunk, &x0, &y0, &z0, &x1, &y1, &z1);
+        double dx = (x0 + x1) / 2.0 - spawn_point.x;
+        double dy = (y0 + y1) / 2.0 - spawn_point.y;
+        double dz = (z0 + z1) / 2.0 - spawn_point.z;
+        double distance = dx * dx + dy * dy + dz * dz;
+        int i = chunk;
+        for (; i > 0 && distances[i - 1] > distance; i--) {
+            distances[i] = distances[i - 1];
+            stream_order[i] = stream_order[i - 1];
+        }
+        distances[i] = distance;
+        stream_order[i] = chunk;
+    }
+}
+
+void start_world_stream(ENetPeer* peer) {
+    int id = peer->incomingPeerID;
+    stream_peers[id] = peer;
+    stream_next[id] = 0;
+    stream_tokens[id] = JOIN_NEAR_BYTES;
+    stream_world_to(peer);
+}
+
+// Sends stream packets while the peer has tokens left
+void stream_world_to(ENetPeer* peer) {
+    int id = peer->incomingPeerID;
+    ENetPacket* snapshot = world_snapshot_packet();
+    if (!snapshot) return;
+    while (stream_next[id] < MAP_CHUNK_COUNT && stream_tokens[id] > 0) {
+        unsigned char message[SNAPSHOT_HEADER_SIZE + CHUNK_MAX_SIZE + STREAM_PACKET_BYTES];
+        size_t used = SNAPSHOT_HEADER_SIZE;
+        int count = 0;
+        while (stream_next[id] < MAP_CHUNK_COUNT) {
+            int chunk = stream_order[stream_next[id]];
+            size_t size = snapshot_chunk_sizes[chunk];
+            if (count > 0 && used + size > STREAM_PACKET_BYTES) break;
+            memcpy(message + used, snapshot->data + snapshot_chunk_offsets[chunk], size);
+            used += size;
+            count++;
+            stream_next[id]++;
+        }
+        encode_snapshot_header(count, message, sizeof(message));
+        ENetPacket* packet = enet_packet_create(message, used, ENET_PACKET_FLAG_RELIABLE);
+        enet_peer_send(peer, OUTCOME_MAP_UPDATES_CHANEL, packet);
+        stream_tokens[id] -= used;
+    }
+    if (stream_next[id] == MAP_CHUNK_COUNT) {
+        stream_peers[id] = NULL;
+    }
+}
+
+void stream_world() {
+    double now = server_clock_ms();
+    double refill = (now - stream_refilled_ms) * stream_rate / 1000;
+    stream_refilled_ms = now;
+    for (int id = 0; id < MAX_CLIENTS; id++) {
+        if (!stream_peers[id]) continue;
+        stream_tokens[id] += refill;
+        if (stream_tokens[id] > JOIN_NEAR_BYTES) stream_tokens[id] = JOIN_NEAR_BYTES;
+        if (stream_tokens[id] > 0) {
+            PROFILE_SPAN("stream world");
+            stream_world_to(stream_peers[id]);
+        }
+    }
+}
+
+double server_clock_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+ENetPacket* world_snapshot_packet() {
+    if (snapshot_packet && snapshot_version == map_version) {
+        return snapshot_packet;
+    }
+    PROFILE_SPAN("encode_map_snapshot");
+    // encoded straight into the packet, then trimmed
+    ENetPacket* packet = enet_packet_create(NULL, SNAPSHOT_MAX_SIZE, ENET_PACKET_FLAG_RELIABLE);
+    if (!packet) return NULL;
+    int size = encode_map_snapshot(packet->data, SNAPSHOT_MAX_SIZE);
+    if (size < 0) {
+        enet_packet_destroy(packet);
+        return NULL;
+    }
+    enet_packet_resize(packet, size);
+    index_snapshot_chunks(packet->data, size, snapshot_chunk_offsets, snapshot_chunk_sizes);
+    packet->referenceCount++;
+    release_snapshot_packet();
+    snapshot_packet = packet;
+    snapshot_version = map_version;
+    printf("world snapshot %u encoded, %d bytes (%zu raw)\n", map_version, size, sizeof(map));
+    return packet;
+}
+
+// Gives up the server's reference, ENet frees the packet once no peer still sends it
+void release_snapshot_packet() {
+    if (snapshot_packet && --snapshot_packet->referenceCount == 0) {
+        enet_packet_destroy(snapshot_packet);
+    }
+    snapshot_packet = NULL;
+}
+
+void queue_join(ENetPeer* peer) {
+    if (join_queue_length == MAX_CLIENTS) return; // cannot happen, one entry per peer
+    join_queue[join_queue_length++] = peer;
+}
+
+void drop_queued_join(ENetPeer* peer) {
+    int kept = 0;
+    for (int i = 0; i < join_queue_length; i++) {
+        if (join_queue[i] != peer) join_queue[kept++] = join_queue[i];
+    }
+    join_queue_length = kept;
+}
+
+// Sends the world and a player to as many queued peers as the join rate allows, returns
+// how many were admitted
+int admit_queued_joins(ENetHost* server) {
+    double now = server_clock_ms();
+    double burst = join_rate > 1 ? join_rate : 1;
+    join_tokens += (now - join_refilled_ms) * join_rate / 1000;
+    if (join_tokens > burst || join_rate <= 0) join_tokens = burst;
+    join_refilled_ms = now;
+
+    int admitted = 0;
+    int waiting = 0; // kept in the queue, in order
+    for (int i = 0; i < join_queue_length; i++) {
+        ENetPeer* peer = join_queue[i];
+        int id = peer->incomingPeerID;
+        bool ready = !join_expects_hashes[id] || join_hashes_size[id] > 0 ||
+                     now - join_connected_ms[id] > JOIN_HASHES_TIMEOUT_MS;
+        if (!ready || (join_tokens < 1 && join_rate > 0)) {
+            join_queue[waiting++] = peer;
+            continue;
+        }
+        admitted++;
+        join_tokens--;
+
+        // Initialize the client's state:
+        player_t new_player;
+        init_player(&new_player);
+
+        PROFILE_SPAN("new player");
+        send_data_to_new_player(&new_player, peer, server);
+    }
+    join_queue_length = waiting;
+    if (admitted > 0 && join_queue_length > 0) {
+        printf("%d joins queued\n", join_queue_length);
+    }
+    return admitted;
 }
 
 ENetHost* create_game_server() {
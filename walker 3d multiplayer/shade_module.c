@@ -0,0 +1,58 @@
+#include "shade_module.h"
+#include <string.h>
+
+void build_shade_table(shade_table_t* table, const char* ramp, double step,
+                       double fog_start, double fog_end, int fog_color) {
+    int ramp_length = strlen(ramp);
+    for (int i = 0; i < SHADE_LUT_SIZE; i++) {
+        double depth = (double)i / SHADE_LUT_SCALE;
+        double index = depth / step;
+        bool fogged = false;
+        if (fog_start != NO_FOG && depth >= fog_start) {
+            double amount = (fog_end > fog_start) ? (depth - fog_start) / (fog_end - fog_start) : 1;
+            if (amount >= 1) {
+                amount = 1;
+                fogged = true;
+            }
+            index += amount * (ramp_length - 1 - index);
+        }
+        if (index > ramp_length - 1) {
+            index = ramp_length - 1;
+        }
+        table->lut[i] = ramp[(int)index];
+        table->fogged[i] = fogged;
+    }
+    for (int light = 0; light < 256; light++) {
+        table->light_offset[light] = (short)((SHADE_FULL_LIGHT - light) * SHADE_LIGHT_STEPS * step
+                                             * SHADE_LUT_SCALE / SHADE_FULL_LIGHT);
+    }
+    table->flag_char[0] = 0;
+    table->flag_char[SHADE_FLAG_SKY] = '^';
+    table->flag_char[SHADE_FLAG_PLAYER] = '#';
+    table->flag_char[SHADE_FLAG_SKY | SHADE_FLAG_PLAYER] = '^';
+    table->fog_color = fog_color;
+}
+
+// No branches on the data, so the loop vectorizes
+void shade_cells(const shade_table_t* table, const float* depth, const unsigned char* flags,
+                 const unsigned char* color, const unsigned char* light, int count, chtype* out) {
+    for (int p = 0; p < count; p++) {
+        int index = (int)(depth[p] * SHADE_LUT_SCALE) + table->light_offset[light[p]];
+        index = index < SHADE_LUT_SIZE - 1 ? index : SHADE_LUT_SIZE - 1;
+        chtype flag_char = (unsigned char)table->flag_char[flags[p] & 3];
+        chtype ch = flag_char ? flag_char : (unsigned char)table->lut[index];
+        chtype pair = table->fogged[index] ? table->fog_color : color[p];
+        out[p] = ch | COLOR_PAIR(pair);
+    }
+}
+
+char shade_char(const shade_table_t* table, double depth, int flags, int light) {
+    if (table->flag_char[flags & 3]) {
+        return table->flag_char[flags & 3];
+    }
+    int index = (int)(depth * SHADE_LUT_SCALE) + table->light_offset[light & 255];
+    if (index > SHADE_LUT_SIZE - 1) {
+        index = SHADE_LUT_SIZE - 1;
+    }
+    return table->lut[index];
+}
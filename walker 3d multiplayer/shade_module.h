@@ -0,0 +1,41 @@
+#ifndef SHADE_MODULE_H
+#define SHADE_MODULE_H
+
+#include <ncurses.h>
+
+// Depth is quantized to 1/SHADE_LUT_SCALE of a cell
+#define SHADE_LUT_SCALE 4
+#define SHADE_LUT_SIZE 512
+
+// G-buffer flags
+#define SHADE_FLAG_SKY 1    // ray left through the floor or the ceiling
+#define SHADE_FLAG_PLAYER 2 // reflected ray came back to the viewer
+
+#define DEFAULT_SHADE_RAMP "@%*;+=-:. "
+#define NO_FOG -1
+
+// Light byte of an unshaded surface; darker faces look up to SHADE_LIGHT_STEPS ramp
+// characters farther away
+#define SHADE_FULL_LIGHT 255
+#define SHADE_LIGHT_STEPS 2
+
+typedef struct {
+    char lut[SHADE_LUT_SIZE];
+    unsigned char fogged[SHADE_LUT_SIZE]; // 1 where fog_color replaces the voxel color
+    char flag_char[4];                    // indexed by flags, 0 keeps the ramp character
+    short light_offset[256];              // LUT entries added for a light byte
+    int fog_color;
+} shade_table_t;
+
+// `ramp` goes from the nearest to the farthest character, each covering `step` cells.
+// Between fog_start and fog_end characters fade to the end of the ramp; past fog_end
+// the color becomes fog_color. Pass NO_FOG as fog_start to disable fog.
+void build_shade_table(shade_table_t* table, const char* ramp, double step,
+                       double fog_start, double fog_end, int fog_color);
+
+// Shading pass over the G-buffer planes, writes straight into the presenter's cells
+void shade_cells(const shade_table_t* table, const float* depth, const unsigned char* flags,
+                 const unsigned char* color, const unsigned char* light, int count, chtype* out);
+char shade_char(const shade_table_t* table, double depth, int flags, int light);
+
+#endif // SHADE_MODULE_H
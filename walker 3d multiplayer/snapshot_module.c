@@ -0,0 +1,371 @@
+#include "snapshot_module.h"
+#include "protocol_module.h"
+#include <string.h>
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+static unsigned long long chunk_hashes[MAP_CHUNK_COUNT];
+static unsigned long long subtree_hashes[MAP_SUBTREE_COUNT];
+static unsigned long long root_hash;
+static bool hashes_valid = false;
+static unsigned int hashed_version;
+
+static unsigned char* put_u16(unsigned char* out, unsigned int value) {
+    out[0] = value & 0xff;
+    out[1] = (value >> 8) & 0xff;
+    return out + 2;
+}
+
+static unsigned int get_u16(const unsigned char* in) {
+    return in[0] | (in[1] << 8);
+}
+
+// type, color and symbol of a voxel in one comparable value
+static unsigned int voxel_key(const object_t* voxel) {
+    return (voxel->type & 0xff) | ((voxel->color & 0xff) << 8) |
+           ((unsigned char)voxel->symbol << 16);
+}
+
+void map_chunk_bounds(int chunk, int* x0, int* y0, int* z0, int* x1, int* y1, int* z1) {
+    *x0 = chunk % CHUNKS_X * CHUNK_SIZE;
+    *y0 = chunk / CHUNKS_X % CHUNKS_X * CHUNK_SIZE;
+    *z0 = chunk / (CHUNKS_X * CHUNKS_X) * CHUNK_SIZE;
+    *x1 = *x0 + CHUNK_SIZE < MAP_SIZE ? *x0 + CHUNK_SIZE : MAP_SIZE;
+    *y1 = *y0 + CHUNK_SIZE < MAP_SIZE ? *y0 + CHUNK_SIZE : MAP_SIZE;
+    *z1 = *z0 + CHUNK_SIZE < MAP_HEIGHT ? *z0 + CHUNK_SIZE : MAP_HEIGHT;
+}
+
+int encode_map_chunk(int chunk, unsigned char* out, size_t size) {
+    int x0, y0, z0, x1, y1, z1;
+    map_chunk_bounds(chunk, &x0, &y0, &z0, &x1, &y1, &z1);
+
+    // palette first, the runs only need its size to be known once they are written
+    unsigned int palette[CHUNK_PALETTE_MAX];
+    unsigned char indices[CHUNK_VOXELS];
+    int palette_size = 0;
+    int voxels = 0;
+    for (int z = z0; z < z1; z++) {
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                unsigned int key = voxel_key(&map[z][y][x]);
+                int index = voxels > 0 && palette[indices[voxels - 1]] == key
+                                ? indices[voxels - 1] : 0;
+                while (index < palette_size && palette[index] != key) index++;
+                if (index == palette_size) {
+                    if (palette_size == CHUNK_PALETTE_MAX) return -1;
+                    palette[palette_size++] = key;
+                }
+                indices[voxels++] = index;
+            }
+        }
+    }
+
+    size_t needed = CHUNK_HEADER_SIZE + 1 + palette_size * 3;
+    if (size < needed) return -1;
+    unsigned char* p = out + CHUNK_HEADER_SIZE;
+    *p++ = palette_size - 1;
+    for (int i = 0; i < palette_size; i++) {
+        *p++ = palette[i] & 0xff;
+        *p++ = (palette[i] >> 8) & 0xff;
+        *p++ = (palette[i] >> 16) & 0xff;
+    }
+    if (palette_size > 1) {
+        for (int i = 0; i < voxels;) {
+            int run = 1;
+            while (i + run < voxels && run < 256 && indices[i + run] == indices[i]) run++;
+            if ((size_t)(p - out) + 2 > size) return -1;
+            *p++ = run - 1;
+            *p++ = indices[i];
+            i += run;
+        }
+    }
+    put_u16(out, chunk);
+    put_u16(out + 2, (p - out) - CHUNK_HEADER_SIZE);
+    return p - out;
+}
+
+int encode_map_snapshot(unsigned char* out, size_t size) {
+    int chunks[MAP_CHUNK_COUNT];
+    for (int chunk = 0; chunk < MAP_CHUNK_COUNT; chunk++) {
+        chunks[chunk] = chunk;
+    }
+    return encode_map_chunks(chunks, MAP_CHUNK_COUNT, out, size);
+}
+
+int encode_map_chunks(const int* chunks, int count, unsigned char* out, size_t size) {
+    if (encode_snapshot_header(count, out, size) < 0) return -1;
+    size_t used = SNAPSHOT_HEADER_SIZE;
+    for (int i = 0; i < count; i++) {
+        if (chunks[i] < 0 || chunks[i] >= MAP_CHUNK_COUNT) return -1;
+        int written = encode_map_chunk(chunks[i], out + used, size - used);
+        if (written < 0) return -1;
+        used += written;
+    }
+    return used;
+}
+
+int encode_snapshot_header(int chunk_count, unsigned char* out, size_t size) {
+    if (size < SNAPSHOT_HEADER_SIZE || chunk_count < 0 || chunk_count > MAP_CHUNK_COUNT) {
+        return -1;
+    }
+    out[0] = MESSAGE_HEADER(MESSAGE_MAP_SNAPSHOT);
+    out[1] = SNAPSHOT_VERSION;
+    out[2] = MAP_SIZE;
+    out[3] = MAP_HEIGHT;
+    out[4] = CHUNK_SIZE;
+    out[5] = map_version & 0xff;
+    out[6] = (map_version >> 8) & 0xff;
+    out[7] = (map_version >> 16) & 0xff;
+    out[8] = (map_version >> 24) & 0xff;
+    put_u16(out + 9, chunk_count);
+    return SNAPSHOT_HEADER_SIZE;
+}
+
+int index_snapshot_chunks(const unsigned char* data, size_t size,
+                          size_t offsets[MAP_CHUNK_COUNT], size_t sizes[MAP_CHUNK_COUNT]) {
+    if (size < SNAPSHOT_HEADER_SIZE || data[0] != MESSAGE_HEADER(MESSAGE_MAP_SNAPSHOT)) return -1;
+    memset(sizes, 0, sizeof(size_t) * MAP_CHUNK_COUNT);
+    int chunk_count = get_u16(data + 9);
+    size_t used = SNAPSHOT_HEADER_SIZE;
+    for (int i = 0; i < chunk_count; i++) {
+        if (size - used < CHUNK_HEADER_SIZE) return -1;
+        int chunk = get_u16(data + used);
+        size_t chunk_size = CHUNK_HEADER_SIZE + get_u16(data + used + 2);
+        if (chunk >= MAP_CHUNK_COUNT || size - used < chunk_size) return -1;
+        offsets[chunk] = used;
+        sizes[chunk] = chunk_size;
+        used += chunk_size;
+    }
+    return chunk_count;
+}
+
+int decode_map_chunk(const unsigned char* data, size_t size) {
+    if (size < CHUNK_HEADER_SIZE + 1) return -1;
+    int chunk = get_u16(data);
+    size_t payload = get_u16(data + 2);
+    if (chunk >= MAP_CHUNK_COUNT || size < CHUNK_HEADER_SIZE + payload || payload < 1) return -1;
+    const unsigned char* p = data + CHUNK_HEADER_SIZE;
+    const unsigned char* end = p + payload;
+
+    int palette_size = *p++ + 1;
+    if ((size_t)(end - p) < (size_t)palette_size * 3) return -1;
+    object_t palette[CHUNK_PALETTE_MAX];
+    for (int i = 0; i < palette_size; i++) {
+        palette[i].type = (signed char)p[0];
+        palette[i].color = p[1];
+        palette[i].symbol = p[2];
+        p += 3;
+    }
+
+    int x0, y0, z0, x1, y1, z1;
+    map_chunk_bounds(chunk, &x0, &y0, &z0, &x1, &y1, &z1);
+    int run = palette_size == 1 ? -1 : 0; // voxels left in the current run, -1: endless
+    int index = 0;
+    for (int z = z0; z < z1; z++) {
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                if (run == 0) {
+                    if (end - p < 2 || p[1] >= palette_size) return -1;
+                    run = p[0] + 1;
+                    index = p[1];
+                    p += 2;
+                }
+                map[z][y][x] = palette[index];
+                if (run > 0) run--;
+            }
+        }
+    }
+    if (run > 0 || p != end) return -1; // runs longer or shorter than the chunk
+    return CHUNK_HEADER_SIZE + payload;
+}
+
+long decode_map_snapshot(const unsigned char* data, size_t size) {
+    if (size < SNAPSHOT_HEADER_SIZE || data[0] != MESSAGE_HEADER(MESSAGE_MAP_SNAPSHOT) ||
+        data[1] != SNAPSHOT_VERSION || data[2] != MAP_SIZE || data[3] != MAP_HEIGHT ||
+        data[4] != CHUNK_SIZE) {
+        return -1;
+    }
+    unsigned long version = data[5] | (data[6] << 8) | (data[7] << 16) |
+                            ((unsigned long)data[8] << 24);
+    int chunk_count = get_u16(data + 9);
+    size_t used = SNAPSHOT_HEADER_SIZE;
+    for (int i = 0; i < chunk_count; i++) {
+        int consumed = decode_map_chunk(data + used, size - used);
+        if (consumed < 0) return -1;
+        used += consumed;
+    }
+    refresh_map_caches();
+    return version;
+}
+
+static unsigned long long hash_bytes(unsigned long long hash, const unsigned char* bytes,
+                                     size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static unsigned long long hash_u64s(const unsigned long long* values, int count) {
+    unsigned long long hash = FNV_OFFSET;
+    for (int i = 0; i < count; i++) {
+        unsigned char bytes[8];
+        for (int b = 0; b < 8; b++) bytes[b] = (values[i] >> (8 * b)) & 0xff;
+        hash = hash_bytes(hash, bytes, 8);
+    }
+    return hash;
+}
+
+// the last subtree holds what is left of the chunks
+static int subtree_chunk_count(int subtree) {
+    int first = subtree * MERKLE_FANOUT;
+    return first + MERKLE_FANOUT < MAP_CHUNK_COUNT ? MERKLE_FANOUT : MAP_CHUNK_COUNT - first;
+}
+
+static void update_map_hashes() {
+    if (hashes_valid && hashed_version == map_version) return;
+    for (int chunk = 0; chunk < MAP_CHUNK_COUNT; chunk++) {
+        int x0, y0, z0, x1, y1, z1;
+        map_chunk_bounds(chunk, &x0, &y0, &z0, &x1, &y1, &z1);
+        unsigned long long hash = FNV_OFFSET;
+        for (int z = z0; z < z1; z++) {
+            for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++) {
+                    const object_t* voxel = &map[z][y][x];
+                    unsigned char bytes[3] = {voxel->type & 0xff, voxel->color & 0xff,
+                                              (unsigned char)voxel->symbol};
+                    hash = hash_bytes(hash, bytes, 3);
+                }
+            }
+        }
+        chunk_hashes[chunk] = hash;
+    }
+    for (int subtree = 0; subtree < MAP_SUBTREE_COUNT; subtree++) {
+        subtree_hashes[subtree] = hash_u64s(chunk_hashes + subtree * MERKLE_FANOUT,
+                                            subtree_chunk_count(subtree));
+    }
+    root_hash = hash_u64s(subtree_hashes, MAP_SUBTREE_COUNT);
+    hashed_version = map_version;
+    hashes_valid = true;
+}
+
+unsigned long long map_chunk_hash(int chunk) {
+    update_map_hashes();
+    return chunk_hashes[chunk];
+}
+
+unsigned long long map_subtree_hash(int subtree) {
+    update_map_hashes();
+    return subtree_hashes[subtree];
+}
+
+unsigned long long map_root_hash() {
+    update_map_hashes();
+    return root_hash;
+}
+
+static unsigned char* put_u64(unsigned char* out, unsigned long long value) {
+    for (int b = 0; b < 8; b++) out[b] = (value >> (8 * b)) & 0xff;
+    return out + 8;
+}
+
+static unsigned long long get_u64(const unsigned char* in) {
+    unsigned long long value = 0;
+    for (int b = 7; b >= 0; b--) value = (value << 8) | in[b];
+    return value;
+}
+
+int encode_resync_request(unsigned char* out, size_t size) {
+    if (size < RESYNC_REQUEST_SIZE) return -1;
+    update_map_hashes();
+    out[0] = MESSAGE_HEADER(MESSAGE_RESYNC_REQUEST);
+    unsigned char* p = put_u64(out + 1, root_hash);
+    p = put_u16(p, MAP_SUBTREE_COUNT);
+    for (int subtree = 0; subtree < MAP_SUBTREE_COUNT; subtree++) {
+        p = put_u64(p, subtree_hashes[subtree]);
+    }
+    return RESYNC_REQUEST_SIZE;
+}
+
+int differing_subtrees(const unsigned char* request, size_t size, int* subtrees, int capacity) {
+    if (size < RESYNC_REQUEST_SIZE || request[0] != MESSAGE_HEADER(MESSAGE_RESYNC_REQUEST) ||
+        get_u16(request + 9) != MAP_SUBTREE_COUNT) {
+        return -1;
+    }
+    update_map_hashes();
+    if (get_u64(request + 1) == root_hash) return 0;
+    int count = 0;
+    for (int subtree = 0; subtree < MAP_SUBTREE_COUNT; subtree++) {
+        if (get_u64(request + 11 + 8 * subtree) == subtree_hashes[subtree]) continue;
+        if (count == capacity) return -1;
+        subtrees[count++] = subtree;
+    }
+    return count;
+}
+
+int encode_chunk_hashes(const int* subtrees, int count, unsigned char* out, size_t size) {
+    if (count < 0 || count > MAP_SUBTREE_COUNT || size < 3) return -1;
+    update_map_hashes();
+    out[0] = MESSAGE_HEADER(MESSAGE_CHUNK_HASHES);
+    unsigned char* p = put_u16(out + 1, count);
+    for (int i = 0; i < count; i++) {
+        int subtree = subtrees[i];
+        if (subtree < 0 || subtree >= MAP_SUBTREE_COUNT) return -1;
+        int chunks = subtree_chunk_count(subtree);
+        if ((size_t)(p - out) + 2 + 8 * chunks > size) return -1;
+        p = put_u16(p, subtree);
+        for (int k = 0; k < chunks; k++) {
+            p = put_u64(p, chunk_hashes[subtree * MERKLE_FANOUT + k]);
+        }
+    }
+    return p - out;
+}
+
+int differing_chunks(const unsigned char* hashes, size_t size, int* chunks, int capacity) {
+    if (size < 3 || hashes[0] != MESSAGE_HEADER(MESSAGE_CHUNK_HASHES)) return -1;
+    int subtree_count = get_u16(hashes + 1);
+    if (subtree_count > MAP_SUBTREE_COUNT) return -1;
+    update_map_hashes();
+    const unsigned char* p = hashes + 3;
+    const unsigned char* end = hashes + size;
+    int count = 0;
+    for (int i = 0; i < subtree_count; i++) {
+        if (end - p < 2) return -1;
+        int subtree = get_u16(p);
+        p += 2;
+        if (subtree >= MAP_SUBTREE_COUNT) return -1;
+        int first = subtree * MERKLE_FANOUT;
+        int subtree_chunks = subtree_chunk_count(subtree);
+        if (end - p < 8 * subtree_chunks) return -1;
+        for (int k = 0; k < subtree_chunks; k++, p += 8) {
+            if (get_u64(p) == chunk_hashes[first + k]) continue;
+            if (count == capacity) return -1;
+            chunks[count++] = first + k;
+        }
+    }
+    return count;
+}
+
+int encode_chunk_request(const int* chunks, int count, unsigned char* out, size_t size) {
+    if (count < 0 || count > MAP_CHUNK_COUNT || size < CHUNK_REQUEST_SIZE(count)) return -1;
+    out[0] = MESSAGE_HEADER(MESSAGE_CHUNK_REQUEST);
+    unsigned char* p = put_u16(out + 1, count);
+    for (int i = 0; i < count; i++) {
+        p = put_u16(p, chunks[i]);
+    }
+    return CHUNK_REQUEST_SIZE(count);
+}
+
+int decode_chunk_request(const unsigned char* data, size_t size, int* chunks, int capacity) {
+    if (size < CHUNK_REQUEST_SIZE(0) || data[0] != MESSAGE_HEADER(MESSAGE_CHUNK_REQUEST)) {
+        return -1;
+    }
+    int count = get_u16(data + 1);
+    if (count > capacity || size < CHUNK_REQUEST_SIZE(count)) return -1;
+    for (int i = 0; i < count; i++) {
+        chunks[i] = get_u16(data + 3 + 2 * i);
+        if (chunks[i] >= MAP_CHUNK_COUNT) return -1;
+    }
+    return count;
+}
@@ -0,0 +1,101 @@
+#ifndef SNAPSHOT_MODULE_H
+#define SNAPSHOT_MODULE_H
+
+#include <stddef.h>
+#include "map_module.h"
+
+// Binary world snapshot. The map is cut into CHUNK_SIZE^3 chunks (clipped at the border),
+// each stored as a palette of distinct voxels plus run-length encoded palette indices.
+//
+// snapshot: header (SNAPSHOT_HEADER_SIZE bytes)
+//   u8  MESSAGE_HEADER(MESSAGE_MAP_SNAPSHOT)
+//   u8  SNAPSHOT_VERSION
+//   u8  MAP_SIZE, u8 MAP_HEIGHT, u8 CHUNK_SIZE
+//   u32 world version (map_version of the sender)
+//   u16 chunk count
+// followed by that many chunks:
+//   u16 chunk index, u16 payload bytes
+//   u8  palette entries - 1, then per entry: i8 type, u8 color, u8 symbol
+//   runs of u8 length - 1, u8 palette index, covering the chunk in z, y, x order
+//   (no runs when the palette has a single entry)
+// All integers are little-endian. Encoding and decoding are single linear passes.
+// A snapshot may carry any subset of the chunks, the others keep what the map had.
+//
+// Hash tree: every chunk has a 64-bit FNV-1a hash of its voxels, MERKLE_FANOUT
+// consecutive chunk hashes make a subtree hash and the subtree hashes make the root.
+// A resync walks down the tree in two round trips, so it costs the size of the difference
+// rather than of the world:
+// 1. the requester sends its root and subtree hashes
+//      u8  MESSAGE_HEADER(MESSAGE_RESYNC_REQUEST)
+//      u64 root hash, u16 subtree count, then the subtree hashes
+//    and gets an empty snapshot back when the roots match, otherwise
+// 2. the chunk hashes of the sender under the subtrees that differ
+//      u8  MESSAGE_HEADER(MESSAGE_CHUNK_HASHES), u16 subtree count,
+//      then per subtree: u16 subtree index, the hashes of its chunks
+// 3. the requester compares them to its own and asks for the chunks that differ
+//      u8  MESSAGE_HEADER(MESSAGE_CHUNK_REQUEST), u16 chunk count, then u16 chunk indices
+//    which come back as a snapshot, an empty one when none differ.
+
+#define SNAPSHOT_VERSION 1
+
+#define CHUNK_SIZE 8
+#define CHUNKS_X ((MAP_SIZE + CHUNK_SIZE - 1) / CHUNK_SIZE)
+#define CHUNKS_Z ((MAP_HEIGHT + CHUNK_SIZE - 1) / CHUNK_SIZE)
+#define MAP_CHUNK_COUNT (CHUNKS_Z * CHUNKS_X * CHUNKS_X)
+
+#define SNAPSHOT_HEADER_SIZE 11
+#define CHUNK_HEADER_SIZE 4
+#define CHUNK_PALETTE_MAX 256
+#define CHUNK_VOXELS (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
+#define CHUNK_MAX_SIZE (CHUNK_HEADER_SIZE + 1 + CHUNK_PALETTE_MAX * 3 + CHUNK_VOXELS * 2)
+#define SNAPSHOT_MAX_SIZE (SNAPSHOT_HEADER_SIZE + MAP_CHUNK_COUNT * CHUNK_MAX_SIZE)
+
+#define MERKLE_FANOUT 8
+#define MAP_SUBTREE_COUNT ((MAP_CHUNK_COUNT + MERKLE_FANOUT - 1) / MERKLE_FANOUT)
+#define RESYNC_REQUEST_SIZE (11 + 8 * MAP_SUBTREE_COUNT)
+#define CHUNK_HASHES_MAX_SIZE (3 + MAP_SUBTREE_COUNT * (2 + 8 * MERKLE_FANOUT))
+#define CHUNK_REQUEST_SIZE(count) (3 + 2 * (size_t)(count))
+
+// voxel bounds of a chunk, [x0, x1) x [y0, y1) x [z0, z1)
+void map_chunk_bounds(int chunk, int* x0, int* y0, int* z0, int* x1, int* y1, int* z1);
+
+// Bytes written, or -1 when `size` is too small or a chunk has more than
+// CHUNK_PALETTE_MAX distinct voxels
+int encode_map_chunk(int chunk, unsigned char* out, size_t size);
+int encode_map_snapshot(unsigned char* out, size_t size);
+// snapshot of only the listed chunks
+int encode_map_chunks(const int* chunks, int count, unsigned char* out, size_t size);
+// The header alone, for a snapshot assembled from already encoded chunks
+int encode_snapshot_header(int chunk_count, unsigned char* out, size_t size);
+// Where every chunk of an encoded snapshot starts and how long it is, indexed by chunk;
+// chunks the snapshot lacks get size 0. Returns the chunk count, -1 on malformed data.
+int index_snapshot_chunks(const unsigned char* data, size_t size,
+                          size_t offsets[MAP_CHUNK_COUNT], size_t sizes[MAP_CHUNK_COUNT]);
+
+// Writes the chunk into `map` and returns the bytes consumed, -1 on malformed data.
+// Does not refresh the map caches.
+int decode_map_chunk(const unsigned char* data, size_t size);
+// Decodes a whole snapshot into `map` and refreshes the caches. Returns the sender's
+// world version, or -1 on a malformed snapshot or one for other map dimensions, in which
+// case the chunks before the error are already in `map`.
+long decode_map_snapshot(const unsigned char* data, size_t size);
+
+// Hashes of the current `map`, recomputed on first use after map_version changed
+unsigned long long map_chunk_hash(int chunk);
+unsigned long long map_subtree_hash(int subtree);
+unsigned long long map_root_hash();
+
+int encode_resync_request(unsigned char* out, size_t size);
+// Subtrees whose hashes in a resync request differ from the local map, none when the roots
+// match. Returns their count, -1 on a malformed request or one for another map size.
+int differing_subtrees(const unsigned char* request, size_t size, int* subtrees, int capacity);
+// The local chunk hashes under the listed subtrees
+int encode_chunk_hashes(const int* subtrees, int count, unsigned char* out, size_t size);
+// Chunks whose hashes in a chunk hashes message differ from the local map. Returns their
+// count, -1 on a malformed message.
+int differing_chunks(const unsigned char* hashes, size_t size, int* chunks, int capacity);
+int encode_chunk_request(const int* chunks, int count, unsigned char* out, size_t size);
+// Returns the chunk count, -1 on a malformed request
+int decode_chunk_request(const unsigned char* data, size_t size, int* chunks, int capacity);
+
+#endif // SNAPSHOT_MODULE_H
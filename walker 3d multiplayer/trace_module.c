@@ -0,0 +1,140 @@
+#include "trace_module.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ncurses.h>
+#include "alloc_module.h"
+
+static const char trace_magic[4] = {'W', 'K', 'T', 'R'};
+
+// header: magic, version, walker, seed (u32), lines (u16), cols (u16), little endian
+#define TRACE_HEADER_SIZE 14
+
+static trace_t* new_trace(FILE* file, int walker, unsigned int seed, int lines, int cols) {
+    trace_t* trace = malloc(sizeof(trace_t));
+    if (!trace) return NULL;
+    trace->file = file;
+    trace->walker = walker;
+    trace->seed = seed;
+    trace->lines = lines;
+    trace->cols = cols;
+    trace->frames = 0;
+    trace->total_ms = 0;
+    trace->max_ms = 0;
+    return trace;
+}
+
+static void put_le(unsigned char* out, unsigned int value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out[i] = (value >> (8 * i)) & 0xff;
+    }
+}
+
+static unsigned int get_le(const unsigned char* in, int bytes) {
+    unsigned int value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= (unsigned int)in[i] << (8 * i);
+    }
+    return value;
+}
+
+trace_t* trace_open_record(const char* file_name, int walker, unsigned int seed,
+                           int lines, int cols) {
+    FILE* file = fopen(file_name, "wb");
+    if (!file) {
+        fprintf(stderr, "Cannot create trace file %s\n", file_name);
+        return NULL;
+    }
+    unsigned char header[TRACE_HEADER_SIZE];
+    memcpy(header, trace_magic, 4);
+    header[4] = TRACE_VERSION;
+    header[5] = walker;
+    put_le(header + 6, seed, 4);
+    put_le(header + 10, lines, 2);
+    put_le(header + 12, cols, 2);
+    trace_t* trace = new_trace(file, walker, seed, lines, cols);
+    if (!trace || fwrite(header, 1, TRACE_HEADER_SIZE, file) != TRACE_HEADER_SIZE) {
+        fprintf(stderr, "Failed to write trace file %s\n", file_name);
+        free(trace);
+        fclose(file);
+        return NULL;
+    }
+    return trace;
+}
+
+trace_t* trace_open_replay(const char* file_name, int walker) {
+    FILE* file = fopen(file_name, "rb");
+    if (!file) {
+        fprintf(stderr, "Cannot open trace file %s\n", file_name);
+        return NULL;
+    }
+    unsigned char header[TRACE_HEADER_SIZE];
+    if (fread(header, 1, TRACE_HEADER_SIZE, file) != TRACE_HEADER_SIZE ||
+        memcmp(header, trace_magic, 4) != 0 || header[4] != TRACE_VERSION) {
+        fprintf(stderr, "%s is not a version %d trace file\n", file_name, TRACE_VERSION);
+        fclose(file);
+        return NULL;
+    }
+    if (header[5] != walker) {
+        fprintf(stderr, "%s was recorded by another walker ('%c')\n", file_name, header[5]);
+        fclose(file);
+        return NULL;
+    }
+    trace_t* trace = new_trace(file, walker, get_le(header + 6, 4),
+                               get_le(header + 10, 2), get_le(header + 12, 2));
+    if (!trace) {
+        fclose(file);
+        return NULL;
+    }
+    return trace;
+}
+
+void trace_record_key(trace_t* trace, int key) {
+    if (key == EOF) return;
+    fputc(key, trace->file);
+}
+
+int trace_next_key(trace_t* trace) {
+    return fgetc(trace->file);
+}
+
+double trace_clock_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+void trace_frame_time(trace_t* trace, int key, double frame_ms) {
+    if (trace->frames == 0) {
+        printf("frame,key,frame_ms\n");
+    }
+    printf("%d,%d,%.4f\n", trace->frames, key, frame_ms);
+    trace->frames++;
+    trace->total_ms += frame_ms;
+    if (frame_ms > trace->max_ms) trace->max_ms = frame_ms;
+}
+
+void trace_close(trace_t* trace) {
+    if (!trace) return;
+    if (trace->frames > 0) {
+        fprintf(stderr, "replayed %d frames at %dx%d, mean %.3f ms, max %.3f ms\n",
+                trace->frames, trace->cols, trace->lines,
+                trace->total_ms / trace->frames, trace->max_ms);
+    }
+    fclose(trace->file);
+    free(trace);
+}
+
+int start_replay_screen(int lines, int cols) {
+    FILE* null_output = fopen("/dev/null", "w");
+    if (!null_output) return -1;
+    SCREEN* screen = newterm(getenv("TERM") ? NULL : "xterm", null_output, stdin);
+    if (!screen) {
+        fprintf(stderr, "Cannot create a replay screen\n");
+        fclose(null_output);
+        return -1;
+    }
+    set_term(screen);
+    resizeterm(lines, cols);
+    return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef TRACE_MODULE_H
+#define TRACE_MODULE_H
+
+#include <stdio.h>
+
+// Input traces: the world seed, the terminal size and every key fed to update_player,
+// one byte per key. Replaying one runs the same frames again without a terminal.
+
+#define TRACE_VERSION 1
+
+// Walker that recorded a trace
+#define TRACE_WALKER_CONSOLE 'c'
+#define TRACE_WALKER_TRACER 't'
+
+typedef struct {
+    FILE* file;
+    int walker;
+    unsigned int seed;
+    int lines;
+    int cols;
+
+    // replay timing
+    int frames;
+    double total_ms;
+    double max_ms;
+} trace_t;
+
+// Returns NULL and prints why on failure
+trace_t* trace_open_record(const char* file_name, int walker, unsigned int seed,
+                           int lines, int cols);
+trace_t* trace_open_replay(const char* file_name, int walker);
+void trace_record_key(trace_t* trace, int key);
+int trace_next_key(trace_t* trace); // EOF when the trace is over
+void trace_close(trace_t* trace); // prints the replay summary to stderr
+
+// Replay timing: one "frame,key,frame_ms" line per frame on stdout
+double trace_clock_ms();
+void trace_frame_time(trace_t* trace, int key, double frame_ms);
+
+// ncurses screen of the recorded size that writes to /dev/null
+int start_replay_screen(int lines, int cols);
+
+#endif // TRACE_MODULE_H
@@ -0,0 +1,347 @@
+#include "view_module.h"
+#include "profile_module.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "alloc_module.h"
+
+// presenter's output buffer, one cell per ray
+static chtype* screen_cells = NULL;
+static int screen_capacity = 0;
+
+int cost_overlay = COST_OVERLAY_OFF;
+static const char* cost_names[] = {"off", "steps", "bounces", "time"};
+static char cost_message[80] = "";
+static int cost_dumps = 0;
+
+// low to high cost
+static const char cost_ramp[] = " .:-=+*#%@";
+static const int cost_colors[] = {3, 3, 6, 6, 2, 2, 4, 4, 1, 1};
+
+static char extra_stats[VIEW_EXTRA_STATS][96];
+
+// Frame pacing. refresh() blocks while the terminal drains, so on a slow link rendering
+// runs ahead of the display. A refresh that blocked says the link is full: frames drawn
+// within the same time again are only drawn into stdscr, and the next refresh sends
+// whatever is newest by then. Serial-like terminals also report their output queue.
+static bool pacing = false;
+static int output_fd = -1; // terminal ncurses writes to, -1 for a replay screen
+static bool frame_waiting = false;
+static int skipped_frames = 0; // frames replaced before they reached the terminal
+static double drain_until_ms = 0; // when the terminal should have taken the last frame
+static double refresh_cost_ms = 0; // time a refresh takes to be accepted, smoothed
+static int last_frame_bytes = 0; // from the output queue, 0 where it is not reported
+
+static int min_int(int a, int b) {
+    return (a < b) ? a : b;
+}
+
+static int max_int(int a, int b) {
+    return (a > b) ? a : b;
+}
+
+void init_ncyrses() {
+    if (!stdscr) {
+        initscr(); // a replay has already set up its own screen
+        output_fd = STDOUT_FILENO;
+    }
+    cbreak();
+    noecho();
+    keypad(stdscr, TRUE);
+    start_color();
+    init_pair(0, COLOR_BLACK, COLOR_BLACK);
+    init_pair(1, COLOR_RED, COLOR_BLACK);
+    init_pair(2, COLOR_GREEN, COLOR_BLACK);
+    init_pair(3, COLOR_BLUE, COLOR_BLACK);
+    init_pair(4, COLOR_YELLOW, COLOR_BLACK);
+    init_pair(5, COLOR_MAGENTA, COLOR_BLACK);
+    init_pair(6, COLOR_CYAN, COLOR_BLACK);
+    init_pair(7, COLOR_WHITE, COLOR_BLACK);
+}
+
+void enable_raw_mode() {
+    struct termios t;
+    tcgetattr(STDIN_FILENO, &t);
+    t.c_lflag &= ~(ICANON | ECHO);
+    tcsetattr(STDIN_FILENO, TCSANOW, &t);
+}
+
+void disable_raw_mode() {
+    struct termios t;
+    tcgetattr(STDIN_FILENO, &t);
+    t.c_lflag |= (ICANON | ECHO);
+    tcsetattr(STDIN_FILENO, TCSANOW, &t);
+}
+
+void fill_minimap(frame_t* frame, player_t* viewer,
+                  object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE]) {
+    int z = (int)viewer->position.z;
+    for (int i = 0; i < MAP_SIZE; i++) {
+        for (int j = 0; j < MAP_SIZE; j++) {
+            frame->buffer[i][j] = map_to_use[z][i][j].symbol;
+        }
+    }
+    // where player looks
+    double view_x = viewer->position.x;
+    double view_y = viewer->position.y;
+    double dx = cos(viewer->angleXY);
+    double dy = sin(viewer->angleXY);
+    while (map_to_use[z][(int)(view_y + dy)][(int)(view_x + dx)].type == VOID_TYPE) {
+        frame->buffer[(int)(view_y + dy)][(int)(view_x + dx)] = '^';
+        view_x += dx;
+        view_y += dy;
+    }
+    frame->buffer[(int)viewer->position.y][(int)viewer->position.x] = PLAYER_AVATAR;
+}
+
+static chtype* presenter_cells(int count) {
+    if (count > screen_capacity) {
+        chtype* cells = realloc(screen_cells, sizeof(chtype) * count);
+        if (!cells) return NULL;
+        screen_cells = cells;
+        screen_capacity = count;
+    }
+    return screen_cells;
+}
+
+static double cost_at(rays_list_t* rays, int mode, int index) {
+    switch (mode) {
+    case COST_OVERLAY_STEPS:
+        return rays->cost_steps[index];
+    case COST_OVERLAY_BOUNCES:
+        return rays->cost_bounces[index];
+    default:
+        return rays->cost_ns[index];
+    }
+}
+
+static double max_cost(rays_list_t* rays, int mode) {
+    double max = 0;
+    for (int c = 0; c < rays->i * rays->j; c++) {
+        double cost = cost_at(rays, mode, c);
+        if (cost > max) max = cost;
+    }
+    return max;
+}
+
+static void cost_cells(rays_list_t* rays, int mode, chtype* cells) {
+    double max = max_cost(rays, mode);
+    for (int c = 0; c < rays->i * rays->j; c++) {
+        int bucket = max > 0 ? (int)(cost_at(rays, mode, c) / max * 9 + 0.5) : 0;
+        cells[c] = cost_ramp[bucket] | COLOR_PAIR(cost_colors[bucket]);
+    }
+    snprintf(cost_message, sizeof(cost_message), "cost %s, max %.0f%s",
+             cost_names[mode], max, mode == COST_OVERLAY_TIME ? " ns" : "");
+}
+
+bool handle_view_key(int input, frame_t* frame) {
+    if (input == COST_OVERLAY_KEY) {
+        cost_overlay = (cost_overlay + 1) % (COST_OVERLAY_TIME + 1);
+        cost_message[0] = '\0';
+        return true;
+    }
+    if (input != COST_DUMP_KEY) return false;
+    if (cost_overlay == COST_OVERLAY_OFF || !frame->rays || !frame->rays->cost_ns) {
+        snprintf(cost_message, sizeof(cost_message), "no cost image to dump");
+        return true;
+    }
+    char file_name[64];
+    snprintf(file_name, sizeof(file_name), "cost_%s_%d.pgm", cost_names[cost_overlay],
+             cost_dumps);
+    if (dump_cost_image(frame, cost_overlay, file_name) == 0) {
+        cost_dumps++;
+        snprintf(cost_message, sizeof(cost_message), "dumped %s", file_name);
+    } else {
+        snprintf(cost_message, sizeof(cost_message), "cannot write %s", file_name);
+    }
+    return true;
+}
+
+int dump_cost_image(frame_t* frame, int mode, const char* file_name) {
+    rays_list_t* rays = frame->rays;
+    if (!rays->cost_ns || mode == COST_OVERLAY_OFF) return -1;
+    FILE* file = fopen(file_name, "wb");
+    if (!file) return -1;
+    double max = max_cost(rays, mode);
+    fprintf(file, "P5\n# %s, max %f\n%d %d\n255\n", cost_names[mode], max, rays->j, rays->i);
+    for (int c = 0; c < rays->i * rays->j; c++) {
+        fputc(max > 0 ? (int)(cost_at(rays, mode, c) / max * 255 + 0.5) : 0, file);
+    }
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+void enable_frame_pacing() {
+    pacing = true;
+}
+
+// Bytes written to the terminal but not sent yet. Linux ptys (ssh, terminal emulators)
+// always report 0, there only the time a refresh blocks tells.
+static int queued_output() {
+    int queued;
+    if (output_fd < 0 || ioctl(output_fd, TIOCOUTQ, &queued) != 0) return 0;
+    return queued;
+}
+
+static bool terminal_has_room() {
+    if (profile_clock_us() / 1000 < drain_until_ms) return false;
+    return queued_output() <= last_frame_bytes / 4;
+}
+
+static void present() {
+    PROFILE_SPAN("refresh");
+    int before = queued_output();
+    double start = profile_clock_us() / 1000;
+    refresh();
+    double end = profile_clock_us() / 1000;
+    int after = queued_output();
+    if (after > before) last_frame_bytes = after - before;
+    double cost = end - start;
+    refresh_cost_ms = refresh_cost_ms > 0 ? refresh_cost_ms * 0.8 + cost * 0.2 : cost;
+    drain_until_ms = cost > PACING_BLOCKED_MS ? end + cost : end;
+    frame_waiting = false;
+}
+
+int pending_frame_retry_ms() {
+    if (!frame_waiting) return -1;
+    double ms = drain_until_ms - profile_clock_us() / 1000;
+    return ms > PACING_RETRY_MS ? (int)ms : PACING_RETRY_MS;
+}
+
+bool present_pending_frame() {
+    if (!frame_waiting || !terminal_has_room()) return false;
+    present();
+    return true;
+}
+
+void set_extra_stat(int slot, const char* text) {
+    if (slot < 0 || slot >= VIEW_EXTRA_STATS) return;
+    snprintf(extra_stats[slot], sizeof(extra_stats[slot]), "%s", text);
+}
+
+bool draw_frame(frame_t* frame, player_t* viewer, const shade_table_t* table, bool with_stats) {
+    PROFILE_SPAN("draw_frame");
+    // every cell is overwritten, so no clear(): it would retransmit the whole screen
+    int I = frame->rays->i;
+    int J = frame->rays->j;
+    int start_for_stats_on_screen = LINES * 0.80;
+    chtype* cells = presenter_cells(I * J);
+    if (cells && cost_overlay != COST_OVERLAY_OFF && frame->rays->cost_ns) {
+        cost_cells(frame->rays, cost_overlay, cells);
+        for (int i = 0; i < I; i++) {
+            mvaddchnstr(i, 0, cells + i * J, J);
+        }
+    } else if (cells) {
+        PROFILE_SPAN("shade and copy cells");
+        shade_cells(table, frame->rays->depth, frame->rays->flags, frame->rays->color,
+                    frame->rays->light, I * J, cells);
+        for (int i = 0; i < I; i++) {
+            mvaddchnstr(i, 0, cells + i * J, J);
+        }
+    }
+    if (with_stats) {
+        mvprintw(start_for_stats_on_screen, COLS * 0.8,
+                 "X: %f Y: %f", viewer->position.x, viewer->position.y);
+        mvprintw(start_for_stats_on_screen + 1, COLS * 0.8,
+                 "angle XY %f", viewer->angleXY / M_PI * 180);
+        mvprintw(start_for_stats_on_screen + 2, COLS * 0.8,
+                 "angle ZY %f", viewer->angleZY / M_PI * 180);
+        mvprintw(start_for_stats_on_screen + 3, COLS * 0.8,
+                 "Position Z %f", viewer->position.z);
+        mvprintw(start_for_stats_on_screen + 4, COLS * 0.8, "I %d", I);
+        mvprintw(start_for_stats_on_screen + 5, COLS * 0.8, "J %d", J);
+        mvprintw(start_for_stats_on_screen + 6, COLS * 0.8,
+                 "into walls %d", frame->rays->rays_into_walls_counter);
+        mvprintw(start_for_stats_on_screen + 7, COLS * 0.8,
+                 "into player %d", frame->rays->rays_into_player_counter);
+        mvprintw(start_for_stats_on_screen + 8, COLS * 0.8,
+                 "mirrored %d", frame->rays->mirrored_count);
+        mvprintw(start_for_stats_on_screen + 9, COLS * 0.8,
+                 "too long %d", frame->rays->rays_to_long_counter);
+        if (pacing) {
+            mvprintw(start_for_stats_on_screen + 10, COLS * 0.8, "skipped %d, tty %.1f ms/frame",
+                     skipped_frames, refresh_cost_ms);
+        }
+        for (int i = 0; i < VIEW_EXTRA_STATS; i++) {
+            if (extra_stats[i][0]) {
+                mvprintw(start_for_stats_on_screen + 11 + i, COLS * 0.8, "%s", extra_stats[i]);
+            }
+        }
+    }
+    if (cost_overlay != COST_OVERLAY_OFF && !frame->rays->cost_ns) {
+        snprintf(cost_message, sizeof(cost_message), "no cost data from this engine");
+    }
+    if (cost_message[0]) {
+        mvprintw(LINES - 1, 0, "%s", cost_message);
+    }
+    render_minimap(frame, viewer, true);
+    if (frame_waiting) skipped_frames++; // replaced by this one before it was shown
+    if (pacing && !terminal_has_room()) {
+        frame_waiting = true;
+        return false;
+    }
+    present();
+    return true;
+}
+
+void render_minimap(frame_t* frame, player_t* viewer, bool frame_color) {
+    int minimap_width = min_int(MINIMAP_WIDTH, MAP_SIZE);
+    int minimap_height = min_int(MINIMAP_HEIGHT, MAP_SIZE);
+    int start_i = 0;
+    if (viewer->position.y + minimap_height / 2 > MAP_SIZE) {
+        start_i = MAP_SIZE - minimap_height;
+    } else {
+        start_i = max_int(viewer->position.y - minimap_height / 2, 0);
+    }
+    int end_i = 0;
+    if (viewer->position.y - minimap_height / 2 < 0) {
+        end_i = minimap_height;
+    } else {
+        end_i = min_int(minimap_height / 2 + viewer->position.y, MAP_SIZE);
+    }
+    int start_j = 0;
+    if (viewer->position.x + minimap_width / 2 > MAP_SIZE) {
+        start_j = MAP_SIZE - minimap_width;
+    } else {
+        start_j = max_int(viewer->position.x - minimap_width / 2, 0);
+    }
+    int end_j = 0;
+    if (viewer->position.x - minimap_width / 2 < 0) {
+        end_j = minimap_width;
+    } else {
+        end_j = min_int(minimap_width / 2 + viewer->position.x, MAP_SIZE);
+    }
+    int z = (int)(viewer->position.z);
+    for (int i = start_i; i < end_i; i++) {
+        for (int j = start_j; j < end_j; j++) {
+            if (frame_color && frame->buffer[i][j] == OBSTACLE_SYMBOL) {
+                char color_type;
+                if (map[0][i][j].color == COLOR_BLACK) {
+                    continue;
+                } else if (map[z][i][j].color == COLOR_RED) {
+                    color_type = 'R';
+                } else if (map[z][i][j].color == COLOR_GREEN) {
+                    color_type = 'G';
+                } else if (map[z][i][j].color == COLOR_YELLOW) {
+                    color_type = 'Y';
+                } else if (map[z][i][j].color == COLOR_BLUE) {
+                    color_type = 'b';
+                } else if (map[z][i][j].color == COLOR_MAGENTA) {
+                    color_type = 'M';
+                } else if (map[z][i][j].color == COLOR_CYAN) {
+                    color_type = 'C';
+                } else if (map[z][i][j].color == COLOR_WHITE) {
+                    color_type = 'W';
+                } else {
+                    color_type = OBSTACLE_SYMBOL;
+                }
+                mvaddch(i - start_i, j - start_j + COLS - MINIMAP_WIDTH, color_type);
+            } else {
+                mvaddch(i - start_i, j - start_j + COLS - MINIMAP_WIDTH,
+                        frame->buffer[i][j]);
+            }
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef VIEW_MODULE_H
+#define VIEW_MODULE_H
+
+#include <stdbool.h>
+#include <ncurses.h>
+#include "map_module.h"
+#include "render_module.h"
+#include "shade_module.h"
+
+#define PLAYER_AVATAR '@'
+#define MINIMAP_HEIGHT 20
+#define MINIMAP_WIDTH 36
+
+typedef struct frame {
+    char buffer[MAP_SIZE][MAP_SIZE]; // minimap of the viewer's layer
+    rays_list_t* rays;
+} frame_t;
+
+// Terminal
+void init_ncyrses();
+void enable_raw_mode();
+void disable_raw_mode();
+
+// Minimap of the viewer's layer with the line of sight and the viewer marked
+void fill_minimap(frame_t* frame, player_t* viewer,
+                  object_t map_to_use[MAP_HEIGHT][MAP_SIZE][MAP_SIZE]);
+void render_minimap(frame_t* frame, player_t* viewer, bool frame_color);
+
+// Shades the frame's G-buffer into the screen, with the stats panel and the minimap.
+// With a cost overlay on and cost planes in the frame, cells show the ray cost instead.
+// Returns false when frame pacing held the frame back from the terminal.
+bool draw_frame(frame_t* frame, player_t* viewer, const shade_table_t* table, bool with_stats);
+
+// Frame pacing for slow terminals: after a refresh that blocked, frames are held back
+// until the terminal had the same time again to drain, and only the newest held frame is
+// sent. A walker that enables it must call present_pending_frame() once
+// pending_frame_retry_ms() (-1 when no frame is held) has passed without new input.
+#define PACING_BLOCKED_MS 4 // a refresh taking longer waited for the terminal
+#define PACING_RETRY_MS 5
+void enable_frame_pacing();
+int pending_frame_retry_ms();
+bool present_pending_frame(); // true when the held frame was sent
+
+// Walker-specific lines under the stats panel, kept until replaced
+#define VIEW_EXTRA_STATS 4
+void set_extra_stat(int slot, const char* text);
+
+// Per-ray cost overlay, needs frames rendered with RENDER_COST
+#define COST_OVERLAY_OFF 0
+#define COST_OVERLAY_STEPS 1
+#define COST_OVERLAY_BOUNCES 2
+#define COST_OVERLAY_TIME 3
+#define COST_OVERLAY_KEY 'h' // cycles the overlay
+#define COST_DUMP_KEY 'H' // dumps the shown cost image
+
+extern int cost_overlay;
+
+// Handles the overlay keys, returns false for any other key
+bool handle_view_key(int input, frame_t* frame);
+// Binary PGM of the cost plane scaled to the frame's maximum, which goes in a comment
+int dump_cost_image(frame_t* frame, int mode, const char* file_name);
+
+#endif // VIEW_MODULE_H
@@ -0,0 +1,132 @@
+#include "world_cache_module.h"
+#include "snapshot_module.h"
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "alloc_module.h"
+
+#define WORLD_CACHE_PATH 512
+#define WORLD_CACHE_SCAN 64 // cached files of one server looked at, newest first
+
+// st_mtim is st_mtimespec on macOS
+#ifdef __APPLE__
+#define MODIFIED_TIME(info) ((info).st_mtimespec)
+#else
+#define MODIFIED_TIME(info) ((info).st_mtim)
+#endif
+
+typedef struct {
+    char name[256];
+    double modified; // seconds, with the sub-second part so saves in one second still order
+} cache_entry_t;
+
+const char* default_world_cache_dir() {
+    static char dir[WORLD_CACHE_PATH];
+    const char* home = getenv("HOME");
+    if (!home || home[0] == '\0') return NULL;
+    snprintf(dir, sizeof(dir), "%s/.cache/walker3d", home);
+    return dir;
+}
+
+// mkdir -p
+static bool make_dirs(const char* path) {
+    char partial[WORLD_CACHE_PATH];
+    snprintf(partial, sizeof(partial), "%s", path);
+    for (char* p = partial + 1; ; p++) {
+        if (*p != '/' && *p != '\0') continue;
+        char end = *p;
+        *p = '\0';
+        if (mkdir(partial, 0755) != 0 && errno != EEXIST) return false;
+        if (end == '\0') return true;
+        *p = end;
+    }
+}
+
+static int newer_first(const void* a, const void* b) {
+    double x = ((const cache_entry_t*)a)->modified;
+    double y = ((const cache_entry_t*)b)->modified;
+    return (x < y) - (x > y);
+}
+
+// Cached files of `server`, newest first
+static int list_cached_worlds(const char* dir, const char* server, cache_entry_t* entries,
+                              int capacity) {
+    DIR* directory = opendir(dir);
+    if (!directory) return 0;
+    char prefix[128];
+    snprintf(prefix, sizeof(prefix), "world-%s-", server);
+    int count = 0;
+    struct dirent* file;
+    while ((file = readdir(directory)) != NULL && count < capacity) {
+        size_t length = strlen(file->d_name);
+        if (strncmp(file->d_name, prefix, strlen(prefix)) != 0 || length < 5 ||
+            strcmp(file->d_name + length - 5, ".snap") != 0) {
+            continue;
+        }
+        char path[WORLD_CACHE_PATH];
+        struct stat info;
+        snprintf(path, sizeof(path), "%s/%s", dir, file->d_name);
+        if (stat(path, &info) != 0) continue;
+        snprintf(entries[count].name, sizeof(entries[count].name), "%s", file->d_name);
+        entries[count].modified =
+            MODIFIED_TIME(info).tv_sec + MODIFIED_TIME(info).tv_nsec / 1e9;
+        count++;
+    }
+    closedir(directory);
+    qsort(entries, count, sizeof(cache_entry_t), newer_first);
+    return count;
+}
+
+bool load_cached_world(const char* dir, const char* server) {
+    cache_entry_t entries[WORLD_CACHE_SCAN];
+    if (list_cached_worlds(dir, server, entries, WORLD_CACHE_SCAN) == 0) return false;
+
+    char path[WORLD_CACHE_PATH];
+    snprintf(path, sizeof(path), "%s/%s", dir, entries[0].name);
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    unsigned char* snapshot = malloc(SNAPSHOT_MAX_SIZE);
+    size_t size = snapshot ? fread(snapshot, 1, SNAPSHOT_MAX_SIZE, file) : 0;
+    fclose(file);
+    bool loaded = size > 0 && decode_map_snapshot(snapshot, size) >= 0;
+    free(snapshot);
+    if (!loaded) {
+        fprintf(stderr, "Removing unreadable cached world %s\n", path);
+        remove(path);
+    }
+    return loaded;
+}
+
+bool save_cached_world(const char* dir, const char* server, unsigned int version) {
+    if (!make_dirs(dir)) return false;
+    char path[WORLD_CACHE_PATH];
+    char temporary[WORLD_CACHE_PATH + 4];
+    snprintf(path, sizeof(path), "%s/world-%s-%u-%016llx.snap", dir, server, version,
+             map_root_hash());
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+
+    unsigned char* snapshot = malloc(SNAPSHOT_MAX_SIZE);
+    if (!snapshot) return false;
+    int size = encode_map_snapshot(snapshot, SNAPSHOT_MAX_SIZE);
+    FILE* file = size >= 0 ? fopen(temporary, "wb") : NULL;
+    bool saved = file && fwrite(snapshot, 1, size, file) == (size_t)size;
+    if (file) saved = fclose(file) == 0 && saved;
+    free(snapshot);
+    // written aside and renamed, so a crash never leaves a torn snapshot under the real name
+    if (!saved || rename(temporary, path) != 0) {
+        remove(temporary);
+        return false;
+    }
+
+    cache_entry_t entries[WORLD_CACHE_SCAN];
+    int count = list_cached_worlds(dir, server, entries, WORLD_CACHE_SCAN);
+    for (int i = WORLD_CACHE_KEEP; i < count; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, entries[i].name);
+        remove(path);
+    }
+    return true;
+}
@@ -0,0 +1,21 @@
+#ifndef WORLD_CACHE_MODULE_H
+#define WORLD_CACHE_MODULE_H
+
+#include <stdbool.h>
+
+// Worlds of the servers a client played on, kept as snapshot files in a cache directory
+// and named world-SERVER-VERSION-HASH.snap after the server's world version and the root
+// hash of the map. Only the newest WORLD_CACHE_KEEP files of a server are kept.
+
+#define WORLD_CACHE_KEEP 4
+
+// Default directory under $HOME, NULL without one
+const char* default_world_cache_dir();
+
+// Loads the newest cached world of `server` into `map`, false when there is none.
+// A file that does not decode is removed.
+bool load_cached_world(const char* dir, const char* server);
+// Stores `map` as world `version` of `server`, creating `dir` when needed
+bool save_cached_world(const char* dir, const char* server, unsigned int version);
+
+#endif // WORLD_CACHE_MODULE_H
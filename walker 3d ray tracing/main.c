@@ -2,232 +2,123 @@
 #include <termios.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
-#include <math.h> 
+#include <math.h>
 #include <ncurses.h>
 #include <stdbool.h>
+#include "../walker 3d multiplayer/map_module.h"
+#include "../walker 3d multiplayer/render_module.h"
+#include "../walker 3d multiplayer/view_module.h"
+#include "../walker 3d multiplayer/trace_module.h"
+#include "../walker 3d multiplayer/profile_module.h"
+#include "../walker 3d multiplayer/alloc_module.h"
 
-#define MAP_SIZE 40
-#define MAP_HEIGHT 20
-#define PLAYER_AVATAR '@'
-#define OBSTICLE '#'
-#define MIRROR 'M'
-
-#define MINIMAP_HEIGHT 20
-#define MINIMAP_WIDTH 36
-
-
-const double max_ray_lenght = MAP_SIZE * 2;
-const double HEIGHT_ANGLE = M_PI/4;
-const double VIEW_ANGLE = M_PI/2;
 const double CAMERA_SPEED = M_PI / 24;
 const double brightnest_level = 5;
 
-typedef struct object {
-    int color;
-    int type;
-    char symbol;
-} object_t;
-
-typedef struct player {
-    double x;
-    double y;
-    double z;
-    double angleXY;
-    double angleZY;
-    int color;
-} player_t;
-
-typedef struct ray {
-    double end_x;
-    double end_y;
-    double end_z;
-    int index;
-    double lenght;
-    bool is_player;
-
-    int color;
-} ray_t;
-
-typedef struct rays_list
-{
-    ray_t* rays;
-    int i; // rays in width
-    int j; // rays in height
-
-    // debug puposes
-    int mirrored_count;
-    int rays_into_walls_counter;
-    int rays_into_player_counter;
-    int rays_to_long_counter;
-} rays_list_t;
-
+int render_features = RENDER_ALL;
+shade_table_t shade_table;
 
-typedef struct frame {
-    char buffer[MAP_SIZE][MAP_SIZE];
-    rays_list_t* rays;
-} frame_t;
-
-
-const int VOID_TYPE = 0;
-const int OBSTICLE_TYPE = 1;
-const int MIRROR_TYPE = 2;
-
-const char OBSTICLE_SYMBOL = '#';
-const char MIRROR_SYMBOL = 'M';
-const char EMPTY_SYMBOL = ' ';
-
-static object_t map[MAP_HEIGHT][MAP_SIZE][MAP_SIZE];
-const double obsticle_width = 2;
-
-void init_ncyrses();
-void initialize_map();
-void add_random_obsticles();
-void enable_raw_mode();
-void disable_raw_mode();
+void init_world(unsigned int seed);
 void init_player(player_t* player);
-frame_t create_frame(player_t* player, bool write_map);
+frame_t create_frame(player_t* player);
 void update_player(int input, player_t* player);
-rays_list_t* create_rays(player_t* player, char buffer[MAP_SIZE][MAP_SIZE]);
-void draw_frame(frame_t* frame, player_t* player);
-char get_wall_char(ray_t* ray);
-bool wall_collision(double pos_x, double pos_y, double pos_z);
-bool mirror_collision(double pos_x, double pos_y, double pos_z);
-bool player_colision(player_t* player, double pos_x, double pos_y, double pos_z);
-int sign(int a);
-object_t create_object(int type);
-int min_int(int a, int b);
-int max_int(int a, int b);
-void render_minimap(frame_t* frame, player_t* player, bool frame_color);
 
-int main() {
+int main(int argc, char** argv) {
+    unsigned int seed = time(NULL);
+    const char* record_name = NULL;
+    const char* replay_name = NULL;
+    const char* profile_name = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-stats") == 0) {
+            render_features &= ~RENDER_DEBUG;
+        } else if (strcmp(argv[i], "--no-reflections") == 0) {
+            render_features &= ~RENDER_REFLECTIONS;
+        } else if (sscanf(argv[i], "--seed=%u", &seed) == 1) {
+            continue;
+        } else if (strncmp(argv[i], "--record=", 9) == 0) {
+            record_name = argv[i] + 9;
+        } else if (strncmp(argv[i], "--replay=", 9) == 0) {
+            replay_name = argv[i] + 9;
+        } else if (strncmp(argv[i], "--profile=", 10) == 0) {
+            profile_name = argv[i] + 10;
+        } else {
+            fprintf(stderr, "Usage: %s [--no-stats] [--no-reflections] [--seed=N] "
+                            "[--record=TRACE | --replay=TRACE] [--profile=TRACE_JSON]\n", argv[0]);
+            return 1;
+        }
+    }
+    // a replay runs the recorded world and keys without a terminal, as fast as possible
+    trace_t* replay = NULL;
+    if (replay_name) {
+        replay = trace_open_replay(replay_name, TRACE_WALKER_TRACER);
+        if (!replay) return 1;
+        seed = replay->seed;
+    }
+    build_shade_table(&shade_table, DEFAULT_SHADE_RAMP, brightnest_level, NO_FOG, NO_FOG, 0);
+
     player_t player;
     init_player(&player);
 
-    initialize_map();
+    init_world(seed);
 
-    enable_raw_mode();
+    if (replay) {
+        if (start_replay_screen(replay->lines, replay->cols) != 0) return 1;
+    } else {
+        enable_raw_mode();
+    }
 
     init_ncyrses();
+    trace_t* record = NULL;
+    if (record_name) {
+        record = trace_open_record(record_name, TRACE_WALKER_TRACER, seed, LINES, COLS);
+    }
+    profile_enable(profile_name != NULL);
     int input = 'x';
     do {
-        frame_t frame = create_frame(&player, false);
-        draw_frame(&frame, &player);
-
-        input = getchar();
-        update_player(input, &player);
+        PROFILE_SPAN("frame");
+        alloc_frame_begin();
+        double frame_start = trace_clock_ms();
+        frame_t frame = create_frame(&player);
+        draw_frame(&frame, &player, &shade_table, render_features & RENDER_DEBUG);
+
+        if (replay) {
+            input = trace_next_key(replay);
+            if (input == EOF) input = 'x';
+        } else {
+            input = getchar();
+        }
+        if (record) trace_record_key(record, input);
+        if (!handle_view_key(input, &frame)) update_player(input, &player);
 
-        free(frame.rays->rays);
-        free(frame.rays);
+        free_rays(frame.rays);
+        alloc_frame_end();
+        if (replay) trace_frame_time(replay, input, trace_clock_ms() - frame_start);
     } while (input != 'x');
 
-    disable_raw_mode();
+    if (!replay) disable_raw_mode();
 
     endwin();
+    if (profile_name) profile_export_chrome(profile_name, "tracer");
+    trace_close(record);
+    trace_close(replay);
     return 0;
 }
 
-void init_ncyrses() {
-    initscr();
-    cbreak();
-    noecho();
-    keypad(stdscr, TRUE);
-    start_color();
-
-    init_pair(0, COLOR_BLACK, COLOR_BLACK);
-    init_pair(1, COLOR_RED, COLOR_BLACK);
-    init_pair(2, COLOR_GREEN, COLOR_BLACK);
-    init_pair(3, COLOR_BLUE, COLOR_BLACK);
-    init_pair(4, COLOR_YELLOW, COLOR_BLACK);
-    init_pair(5, COLOR_MAGENTA, COLOR_BLACK);
-    init_pair(6, COLOR_CYAN, COLOR_BLACK);
-    init_pair(7, COLOR_WHITE, COLOR_BLACK);
-}
-
-object_t create_object(int type) {
-    object_t object;
-    switch (type)
-    {
-    case OBSTICLE_TYPE:
-        object.color = rand() % 7 + 1;
-        object.symbol = OBSTICLE_SYMBOL;
-        object.type = OBSTICLE_TYPE;
-        break;
-    case MIRROR_TYPE:
-        object.symbol = MIRROR_SYMBOL;
-        object.type = MIRROR_TYPE;
-        break;
-    case VOID_TYPE:
-        object.symbol = EMPTY_SYMBOL;
-        object.type = VOID_TYPE;
-        object.color = COLOR_BLACK;
-        break;
-    default:
-        return object;
-    }
-
-    return object;
-}
-
-void initialize_map() {
-    for (int k = 0; k < MAP_HEIGHT; k++) {
-        for (int i = 0; i < MAP_SIZE; i++) {
-            for (int j = 0; j < MAP_SIZE; j++) {
-                // Set borders
-                if (i == 0 || i == MAP_SIZE - 1 || j == 0 || j == MAP_SIZE - 1 || k == 0 || k == MAP_HEIGHT - 1) {
-                    map[k][i][j] = create_object(OBSTICLE_TYPE); 
-                } else {
-                    map[k][i][j] = create_object(VOID_TYPE); 
-                }
-            }
-        }
-    }
-    add_random_obsticles();
-}
-
-void add_random_obsticles() {
-    srand(time(NULL)); 
-
-    int wall_count = 100;
-    for (int i = 0; i < wall_count; i++) {
-        int x = rand() % (MAP_SIZE - 2) + 1; 
-        int y = rand() % (MAP_SIZE - 2) + 1; 
-        int z = rand() % (MAP_HEIGHT - 2) + 1; 
-
-        if (rand() % 2 == 0) {
-            map[z][y][x] = create_object(MIRROR_TYPE); 
-        } else {
-            map[z][y][x] = create_object(OBSTICLE_TYPE); 
-        }
-        // map[z][y][x] = create_object(OBSTICLE_TYPE); 
-
-    }
-
-    for (int k = MAP_HEIGHT*0.1; k < MAP_HEIGHT * 0.8; k++){
-        for (int j = 10; j < 40; j++) {
-            map[k][20][j] = create_object(MIRROR_TYPE); // Horizontal wall at row 20
-        }
-    }
-}
-
-void enable_raw_mode() {
-    struct termios t;
-    tcgetattr(STDIN_FILENO, &t);
-    t.c_lflag &= ~(ICANON | ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &t);
-}
-
-void disable_raw_mode() {
-    struct termios t;
-    tcgetattr(STDIN_FILENO, &t);
-    t.c_lflag |= (ICANON | ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &t);
+// Shared map with random obstacles and a wall of mirrors at row 20
+void init_world(unsigned int seed) {
+    srand(seed);
+    initialize_map();
+    add_random_obstacles();
+    add_mirror_wall();
+    refresh_map_caches();
 }
 
 void init_player(player_t* player) {
-    player->x = 12;
-    player->y = 19;
-    player->z = MAP_HEIGHT / 2;
+    player->position.x = 12;
+    player->position.y = 19;
+    player->position.z = MAP_HEIGHT / 2;
     player->angleXY = M_PI / 2;
     player->angleZY = 0;
     player->color = COLOR_BLACK;
@@ -236,41 +127,42 @@ void init_player(player_t* player) {
 void update_player(int input, player_t* player) {
     double cos_ = cos(player->angleXY) * cos(player->angleZY);
     double sin_ = sin(player->angleXY);
+    position_t* position = &player->position;
 
     switch (input) {
         // Movement
-        case 'd': 
-            if (!wall_collision(player->x - sin_, player->y + cos_, player->z)){
-                player->y += cos_; 
-                player->x -= sin_; 
+        case 'd':
+            if (!wall_collision(map, position->x - sin_, position->y + cos_, position->z)){
+                position->y += cos_;
+                position->x -= sin_;
             }
             break;
-        case 'w': 
-            if (!wall_collision(player->x + cos_, player->y + sin_, player->z)){
-                player->y += sin_; 
-                player->x += cos_; 
+        case 'w':
+            if (!wall_collision(map, position->x + cos_, position->y + sin_, position->z)){
+                position->y += sin_;
+                position->x += cos_;
             }
             break;
-        case 'a': 
-            if (!wall_collision(player->x + sin_, player->y - cos_, player->z)){
-                player->y -= cos_; 
-                player->x += sin_; 
+        case 'a':
+            if (!wall_collision(map, position->x + sin_, position->y - cos_, position->z)){
+                position->y -= cos_;
+                position->x += sin_;
             }
             break;
         case 's':
-            if (!wall_collision(player->y - sin_, player->x - cos_, player->z)){
-                player->y -= sin_; 
-                player->x -= cos_; 
+            if (!wall_collision(map, position->y - sin_, position->x - cos_, position->z)){
+                position->y -= sin_;
+                position->x -= cos_;
             }
             break;
         case 'e':
-            if (player->z < MAP_HEIGHT - 1) {
-                player->z += 1;
+            if (position->z < MAP_HEIGHT - 1) {
+                position->z += 1;
             }
             break;
         case 'q':
-            if (player->z > 1) {
-                player->z -= 1;
+            if (position->z > 1) {
+                position->z -= 1;
             }
             break;
 
@@ -281,317 +173,20 @@ void update_player(int input, player_t* player) {
         case 65: player->angleZY -= CAMERA_SPEED; break; // down
         case 66: player->angleZY += CAMERA_SPEED; break; // up
 
-        case 'p': 
-            map[(int)player->z][(int)player->y][(int)player->x] = create_object(OBSTICLE_TYPE);
-        break; 
+        case 'p':
+            map[(int)position->z][(int)position->y][(int)position->x] = create_object(OBSTACLE_TYPE);
+            refresh_map_caches_at((int)position->x, (int)position->y, (int)position->z);
+        break;
 
         default: break;
     }
 }
 
-frame_t create_frame(player_t* player, bool write_map) {
-    char buffer[MAP_SIZE][MAP_SIZE];
-    
-    for (int i = 0; i < MAP_SIZE; i++) {
-        for (int j = 0; j < MAP_SIZE; j++) {
-            buffer[i][j] = map[(int) player->z][i][j].symbol;
-        }
-    }
-
-    rays_list_t* rays = create_rays(player, buffer);
-    buffer[(int) player->y][(int) player->x] = PLAYER_AVATAR;
-
-    if (write_map) {
-        for (int i = 0; i < MAP_SIZE; i++) {
-            for (int j = 0; j < MAP_SIZE; j++) {
-                putchar(buffer[i][j]);
-            }
-            putchar('\n');
-        }
-    }
-
+frame_t create_frame(player_t* player) {
+    PROFILE_SPAN("create_frame");
     frame_t frame;
-    for (size_t i = 0; i < MAP_SIZE; i++)
-    {
-        for (size_t j = 0; j < MAP_SIZE; j++)
-        {
-            frame.buffer[i][j] = buffer[i][j];
-        }
-        
-    }
-    frame.rays = rays;
-
+    int features = render_features | (cost_overlay ? RENDER_COST : 0);
+    frame.rays = create_rays_with(player, LINES, COLS, map, features);
+    fill_minimap(&frame, player, map);
     return frame;
 }
-
-bool wall_collision(double pos_x, double pos_y, double pos_z) {
-    return map[(int)(pos_z)][(int)(pos_y)][(int)(pos_x)].type == OBSTICLE_TYPE;
-}
-
-bool mirror_collision(double pos_x, double pos_y, double pos_z) {
-    return map[(int)(pos_z)][(int)(pos_y)][(int)(pos_x)].type == MIRROR_TYPE;
-}
-
-bool player_colision(player_t* player, double pos_x, double pos_y, double pos_z) {
-    return ((int) player -> x == (int)(pos_x)) && ((int)player -> y == (int)(pos_y)) && ((int)player -> z == (int)(pos_z));
-}
-
-rays_list_t* create_rays(player_t* player, char buffer[MAP_SIZE][MAP_SIZE]) {
-    int I = LINES;
-    int J = COLS;
-    ray_t* rays = malloc(sizeof(ray_t) * (I * J));
-    if (!rays) return NULL; // Handle allocation failure
-
-    int mirrored_count = 0;
-    int rays_into_walls_counter = 0;
-    int rays_into_player_counter = 0;
-    int rays_to_long_counter = 0;
-
-    for (int i = 0; i < I; i++) {
-        double ZY_angle = -HEIGHT_ANGLE / 2 + ((((double)i + 1) / (double)I) * HEIGHT_ANGLE) + player->angleZY;
-
-        for (int j = 0; j < J; j++) {
-            double XY_angle = -VIEW_ANGLE / 2 + ((((double)j + 1) / (double)J) * VIEW_ANGLE) + player->angleXY;
-
-            double x = player->x + 0.5; 
-            double y = player->y + 0.5; 
-            double z = player->z + 0.5; 
-
-            double dx = 0;
-            double dy = 0;
-            double dz = 0;
-
-            double total_distance = 0;
-
-            int dx_dir = 1;
-            int dy_dir = 1;
-            int dz_dir = 1;
-
-            ray_t ray;
-            ray.index = i * J + j;
-            ray.is_player = false;
-            bool is_reflected = false;
-
-            while (true) {
-                if (total_distance > max_ray_lenght) {
-                    rays_to_long_counter++;
-                    ray.color = COLOR_WHITE;
-                    break;
-                }
-                if (wall_collision(x, y, z)) {
-                    rays_into_walls_counter++;
-                    ray.color = map[(int)(z)][(int)(y)][(int)(x)].color;
-                    break;
-                }
-                if (is_reflected && player_colision(player, x, y, z)) {
-                    ray.is_player = true;
-                    rays_into_player_counter++;
-                    ray.color = player->color;
-                    break;
-                }
-                if (mirror_collision(x, y, z)) {
-                    is_reflected = true;
-                    double prev_x = x - dx;
-                    double prev_y = y - dy;
-                    double prev_z = z - dz;
-                    
-                    if (mirror_collision(prev_x + dx, prev_y, prev_z)) dx_dir *= -1;
-                    if (mirror_collision(prev_x, prev_y + dy, prev_z)) dy_dir *= -1;
-                    if (mirror_collision(prev_x, prev_y, prev_z + dz)) dz_dir *= -1;
-                    
-                    mirrored_count++;
-                }
-
-                dx = cos(ZY_angle) * cos(XY_angle) * dx_dir;
-                dy = cos(ZY_angle) * sin(XY_angle) * dy_dir;
-                dz = sin(ZY_angle) * dz_dir;
-
-                // double d_length = sqrt(dx * dx + dy * dy + dz * dz);
-                total_distance += 1;
-
-                x += dx;
-                y += dy;
-                z += dz;
-            }
-
-            ray.end_x = x;
-            ray.end_y = y;
-            ray.end_z = z;
-            ray.lenght = total_distance;
-
-            rays[ray.index] = ray;
-        }
-    }
-
-    double view_x = player->x;
-    double view_y = player->y;
-
-    double dx = cos(player->angleXY);
-    double dy = sin(player->angleXY);
-
-    while (map[(int)player->z][(int)(view_y + dy)][(int)(view_x + dx)].type == VOID_TYPE) {
-        buffer[(int)(view_y + dy)][(int)(view_x + dx)] = '^';
-        view_x += dx;
-        view_y += dy;
-    }
-
-    rays_list_t* list = malloc(sizeof(rays_list_t));
-    if (!list) {
-        free(rays);
-        return NULL; // Handle allocation failure
-    }
-
-    list->rays = rays;
-    list->i = I;
-    list->j = J;
-    list->mirrored_count = mirrored_count;
-    list->rays_into_player_counter = rays_into_player_counter;
-    list->rays_into_walls_counter = rays_into_walls_counter;
-    list->rays_to_long_counter = rays_to_long_counter;
-
-    return list;
-}
-
-void draw_frame(frame_t* frame, player_t* player) {
-    clear(); 
-    double screen_width = COLS; // Terminal width
-    double screen_height = LINES; // Terminal height
-
-    ray_t* rays = frame->rays->rays;
-    int I = frame->rays->i;
-    int J = frame->rays->j;
-    render_minimap(frame, player, true);
-
-    int start_for_stats_on_screen = LINES*0.80;
-    for (int i = 0; i < I; i++) {
-        double x_acc = 0;
-        double y_acc = 0;
-        double z_acc = 0;
-        for (int j = 0; j < J; j++) {
-            ray_t current_ray = rays[i * J + j];
-
-            double distance = current_ray.lenght;
-            int color = current_ray.color;
-            char wall = get_wall_char(&current_ray);
-
-            attron(COLOR_PAIR(color));
-            mvaddch(i, j, wall); 
-            attroff(COLOR_PAIR(color));
-        }
-    }
-
-
-    mvprintw(start_for_stats_on_screen, COLS*0.8, "X: %f Y: %f", player->x, player->y);
-    mvprintw(start_for_stats_on_screen + 1, COLS*0.8, "angle XY %f", player->angleXY / M_PI * 180);
-    mvprintw(start_for_stats_on_screen + 2, COLS*0.8, "angle ZY %f", player->angleZY / M_PI * 180);
-    mvprintw(start_for_stats_on_screen + 3, COLS*0.8, "Position Z %f", player->z);
-    mvprintw(start_for_stats_on_screen + 4, COLS*0.8, "I %d", I);
-    mvprintw(start_for_stats_on_screen + 5, COLS*0.8, "J %d", J);
-
-    mvprintw(start_for_stats_on_screen + 6, COLS*0.8, "into walls %d", frame->rays->rays_into_walls_counter);
-    mvprintw(start_for_stats_on_screen + 7, COLS*0.8, "into player %d", frame->rays->rays_into_player_counter);
-    mvprintw(start_for_stats_on_screen + 8, COLS*0.8, "mirrored %d", frame->rays->mirrored_count);
-    mvprintw(start_for_stats_on_screen + 9, COLS*0.8, "too long %d", frame->rays->rays_to_long_counter);
-    render_minimap(frame, player, true);
-
-    refresh(); 
-}
-
-void render_minimap(frame_t* frame, player_t* player, bool frame_color) {
-    int minimap_width =  min_int(MINIMAP_WIDTH, MAP_SIZE);
-    int minimap_height = min_int(MINIMAP_HEIGHT, MAP_SIZE);
-    int start_i = 0;
-    if (player->y + minimap_height/2 > MAP_SIZE) {
-        start_i = MAP_SIZE - minimap_height;
-    } else {
-        start_i = max_int(player->y - minimap_height/2, 0);
-    }
-    
-    int end_i = 0;
-    if (player->y - minimap_height/2 < 0) {
-        end_i = minimap_height;
-    } else {
-        end_i = min_int(minimap_height / 2 + player->y, MAP_SIZE);
-    }
-    
-    int start_j = 0;
-    if (player->x + minimap_width/2 > MAP_SIZE) {
-        start_j = MAP_SIZE - minimap_width;
-    } else {
-        start_j = max_int(player->x - minimap_width/2, 0);
-    }
-
-    int end_j = 0;
-    if (player->x - minimap_width/2 < 0) {
-        end_j = minimap_width;
-    } else {
-        end_j = min_int(minimap_width / 2 + player->x, MAP_SIZE);
-    }
-
-    int z = (int)(player->z);
-
-    for (int i = start_i; i < end_i; i++) {
-        for (int j = start_j; j < end_j; j++) {
-            if (frame_color && frame->buffer[i][j] == '#') {
-                char color_type;
-                if (map[0][i][j].color == COLOR_BLACK) {
-                    continue;
-                } else if(map[z][i][j].color == COLOR_RED) {
-                    color_type = 'R';
-                } else if(map[z][i][j].color == COLOR_GREEN) {
-                    color_type = 'G';
-                } else if(map[z][i][j].color == COLOR_YELLOW) {
-                    color_type = 'Y';
-                } else if(map[z][i][j].color == COLOR_BLUE) {
-                    color_type = 'b';
-                } else if(map[z][i][j].color == COLOR_MAGENTA) {
-                    color_type = 'M';
-                } else if(map[z][i][j].color == COLOR_CYAN) {
-                    color_type = 'C';
-                } else if(map[z][i][j].color == COLOR_WHITE) {
-                    color_type = 'W';
-                }
-        
-                mvaddch(i - start_i, j - start_j + COLS - MINIMAP_WIDTH, color_type);
-            } else {
-                mvaddch(i - start_i, j - start_j + COLS - MINIMAP_WIDTH, frame->buffer[i][j]);
-            }
-        }
-    }
-}
-
-char get_wall_char(ray_t* ray) {
-    if (ray->end_z < 1 || ray->end_z > MAP_HEIGHT - 1) {
-        return '^';
-    }
-    if (ray -> is_player) {
-        return '#';
-    }
-    char bightnes[10] = {'@', '%', '*', ';',  '+', '=', '-', ':', '.', ' '};
-
-    int index = ray -> lenght / brightnest_level;
-    if (index > sizeof(bightnes)) {
-        return ' ';
-    }
-    return bightnes[index];
-}
-
-int sign(int a) {
-    return (a > 0) - (a < 0);
-}
-
-int min_int(int a, int b) {
-    if (a > b) {
-        return b;
-    } else {
-        return a;
-    }
-}
-
-int max_int(int a, int b) {
-    if (a < b) {
-        return b;
-    } else {
-        return a;
-    }
-}
\ No newline at end of file